@@ -0,0 +1,46 @@
+#include <microBoxEsp.h>
+
+// Command line, parameter pointers, node tree and history, split by begin()
+uint8_t shellArena[360];
+const MB_LIMITS shellLimits = {64, 8, 0, 0, 0};
+char hostname[] = "serialBash";
+char password[] = "password";
+
+uint16_t ledState = 0;
+
+SerialTransport serialTransport;
+
+PARAM_ENTRY Params[]=
+{
+    {"hostname", hostname, PARTYPE_STRING | PARTYPE_RW, sizeof(hostname), NULL, NULL, 0},
+    {"led", &ledState, PARTYPE_INT | PARTYPE_RW, 0, SetLed, NULL, 0},
+    {"password", password, PARTYPE_STRING | PARTYPE_RW, sizeof(password), NULL, NULL, 0},
+    {NULL, NULL}
+};
+
+void SetLed(uint8_t id)
+{
+    digitalWrite(LED_BUILTIN, ledState);
+}
+
+void getMillis(char **param, uint8_t parCnt)
+{
+    microbox.GetTransport()->print((int)millis());
+    microbox.GetTransport()->println();
+}
+
+void setup()
+{
+    Serial.begin(115200);
+    pinMode(LED_BUILTIN, OUTPUT);
+
+    // Shell directly on the USB serial port, no esp8266 module needed
+    serialTransport.begin(&Serial);
+    microbox.begin(&Params[0], hostname, password, shellArena, sizeof(shellArena), &serialTransport, &shellLimits);
+    microbox.AddCommand("millis", getMillis);
+}
+
+void loop()
+{
+    microbox.cmdParser();
+}
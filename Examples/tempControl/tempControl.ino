@@ -6,7 +6,18 @@
 #include <avr/eeprom.h>
 #include <avr/wdt.h>
 
+// The buffers of rec, begin/commit, trace and /tmp take 432 bytes of
+// SRAM, more than an Uno can spare next to PID and autotune. Set to 1
+// on a board with more RAM to try these commands.
+#define EXTRA_BUFFERS 0
+
 char historyBuf[100];
+#if EXTRA_BUFFERS
+uint8_t recordBuf[120];   // rec start 500 /dev/temp_act /dev/power
+uint8_t txnBuf[24];       // begin; echo .. > /dev/pid/kp; echo .. > /dev/pid/ki; commit
+uint8_t traceBuf[128];    // trace start; trace dump
+uint8_t tmpBuf[160];      // ll /dev > /tmp/snap; cat /tmp/snap
+#endif
 char hostname[] = "incubatDuino";
 char password[] = "password";
 
@@ -43,15 +54,18 @@ PARAM_ENTRY Params[]=
     {"max_div", &maxDiv, PARTYPE_DOUBLE | PARTYPE_RW, 0, NULL, NULL, 0},
     {"password", password, PARTYPE_STRING | PARTYPE_RW, sizeof(password), NULL, NULL, 0},
     {"pid_intervall", &pidIntervall, PARTYPE_INT | PARTYPE_RW, 0, PidSetIntervall, NULL, 0},
-    {"pid_kp", &Kp, PARTYPE_DOUBLE | PARTYPE_RW, 0, PidSetParams, NULL, 0},
-    {"pid_ki", &Ki, PARTYPE_DOUBLE | PARTYPE_RW, 0, PidSetParams, NULL, 0},
-    {"pid_kd", &Kd, PARTYPE_DOUBLE | PARTYPE_RW, 0, PidSetParams, NULL, 0},
+    {"pid/kp", &Kp, PARTYPE_DOUBLE | PARTYPE_RW, 0, PidSetParams, NULL, 0},
+    {"pid/ki", &Ki, PARTYPE_DOUBLE | PARTYPE_RW, 0, PidSetParams, NULL, 0},
+    {"pid/kd", &Kd, PARTYPE_DOUBLE | PARTYPE_RW, 0, PidSetParams, NULL, 0},
     {"power", &Output, PARTYPE_DOUBLE | PARTYPE_RO, 0, NULL, NULL, 0},
     {"temp_act", &temp, PARTYPE_DOUBLE | PARTYPE_RO, 0, NULL, NULL, 0},
     {"temp_setpoint", &Setpoint, PARTYPE_DOUBLE | PARTYPE_RW, 0, NULL, NULL, 0},
     {NULL, NULL}
 };
 
+// Run with "sh defaults"
+const char defaultsScript[] PROGMEM = "echo 40 > /dev/temp_setpoint;echo 25 > /dev/ad_filtercnt\necho 100 > /dev/ad_intervall";
+
 #define MAX_POWER_PORTS 1
 
 typedef struct
@@ -134,7 +148,7 @@ void freeRam(char **param, uint8_t parCnt)
     esp8266.println();
 }
 
-void reset(char **param, uint8_t parCnt)
+void reboot(char **param, uint8_t parCnt)
 {
     wdt_enable(WDTO_15MS);
     while(1)
@@ -170,7 +184,14 @@ void setup()
     microbox.begin(&Params[0], hostname, password, historyBuf, 100);
     microbox.AddCommand("atune", DoATune);
     microbox.AddCommand("free", freeRam);
-    microbox.AddCommand("reset", reset);
+    microbox.AddCommand("reboot", reboot);
+    microbox.AddScript("defaults", defaultsScript);
+#if EXTRA_BUFFERS
+    microbox.SetRecordBuffer(recordBuf, sizeof(recordBuf));
+    microbox.SetTransactionBuffer(txnBuf, sizeof(txnBuf));
+    esp8266.SetTraceBuffer(traceBuf, sizeof(traceBuf));
+    microbox.SetTmpBuffer(tmpBuf, sizeof(tmpBuf));
+#endif
 
 // Uncomment below to configure esp8266 module, configure call is only needed once
 //  esp8266.ConfigSettings(false,"myssid", "mykey");
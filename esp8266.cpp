@@ -7,7 +7,18 @@ Esp8266::Esp8266()
     bufPos = 0;
     ipdWritePos = 0;
     ipdReadPos = 0;
+    txPos = 0;
+    txBuf = txDefault;
+    txSize = ESP_TX_BUF_SIZE;
+    ipdBuf = ipdDefault;
+    ipdSize = ESP_IPD_BUF_SIZE;
+    coalesceLvl = 0;
     discard = 0;
+#if MB_FEATURE_TRACE
+    traceBuf = NULL;
+    traceEntries = 0;
+    traceActive = false;
+#endif
     resp_ready = (const prog_char*)(F("ready"));
     resp_OK = (const prog_char*)(F("OK"));
     resp_BG = (const prog_char*)(F(">"));
@@ -28,28 +39,30 @@ void Esp8266::ConfigSettings(bool apMode, char *ssid, char *key)
 {
     SendInit(true);
 
-    pSerial->print(F("AT+CWMODE="));
+    SerialPrint(F("AT+CWMODE="));
     if(apMode)
-        pSerial->println(F("2"));  // Set AP mode
+        SerialPrint(F("2"));  // Set AP mode
     else
-        pSerial->println(F("1")); // Set STA mode
+        SerialPrint(F("1")); // Set STA mode
+    SerialPrintln();
 
     ReadResponse(resp_OK, 2000);
 
-    pSerial->print(F("AT+CW"));
+    SerialPrint(F("AT+CW"));
     if(apMode)
-        pSerial->print(F("S"));  // Set AP mode
+        SerialPrint(F("S"));  // Set AP mode
     else
-        pSerial->print(F("J")); // Set STA mode
+        SerialPrint(F("J")); // Set STA mode
 
-    pSerial->print(F("AP=\""));
-    pSerial->print(ssid);
-    pSerial->print(F("\",\""));
-    pSerial->print(key);
+    SerialPrint(F("AP=\""));
+    SerialPrint(ssid);
+    SerialPrint(F("\",\""));
+    SerialPrint(key);
     if(apMode)
-        pSerial->println(F("\",8,4"));
+        SerialPrint(F("\",8,4"));
     else
-        pSerial->println(F("\""));
+        SerialPrint(F("\""));
+    SerialPrintln();
     ReadResponse(resp_OK, 30000);
     SendInit();
 }
@@ -57,14 +70,17 @@ void Esp8266::ConfigSettings(bool apMode, char *ssid, char *key)
 void Esp8266::SendInit(bool resetOnly)
 {
     initFinished = false;
-    pSerial->println(ESP_CMD_RESET);
+    SerialPrint(ESP_CMD_RESET);
+    SerialPrintln();
     ReadResponse(resp_ready, 2500);
 
     if(!resetOnly)
     {
-        pSerial->println(ESP_CMD_INIT1);
+        SerialPrint(ESP_CMD_INIT1);
+        SerialPrintln();
         ReadResponse(resp_OK, 1000);
-        pSerial->println(ESP_CMD_INIT2);
+        SerialPrint(ESP_CMD_INIT2);
+        SerialPrintln();
         ReadResponse(resp_OK, 1000);
     }
     initFinished = true;
@@ -88,7 +104,7 @@ uint8_t Esp8266::ReadResponse(const prog_char *resp, unsigned long timeout)
     {
         while(pSerial->available())
         {
-            ch = pSerial->read();
+            ch = SerialRead();
             if(discard)
             {
                 discard--;
@@ -156,8 +172,8 @@ void Esp8266::ReadIpd(uint8_t len)
     do
     {
         while(!pSerial->available());
-        ch = pSerial->read();
-        if(ipdWritePos < ESP_IPD_BUF_SIZE)
+        ch = SerialRead();
+        if(ipdWritePos < ipdSize)
             ipdBuf[ipdWritePos++] = ch;
     }while(--len);
 }
@@ -175,7 +191,7 @@ char Esp8266::read()
         return ret;
     }
     else
-        return pSerial->read();
+        return SerialRead();
 }
 
 bool Esp8266::SerialAvailable()
@@ -191,13 +207,28 @@ uint8_t Esp8266::GetStatus()
     return status;
 }
 
+uint8_t Esp8266::Receive()
+{
+    return ReadResponse();
+}
+
+bool Esp8266::available()
+{
+    return SerialAvailable();
+}
+
+bool Esp8266::IsTelnet()
+{
+    return true;
+}
+
 void Esp8266::clearBuffer(uint8_t avail)
 {
     while(avail--)
     {
         read();
     }
-    avail = esp8266.ReadResponse();
+    avail = ReadResponse();
     while(avail--)
     {
         read();
@@ -208,18 +239,26 @@ void Esp8266::clearBuffer(uint8_t avail)
 
 void Esp8266::Disconnect(const __FlashStringHelper *chan)
 {
-    pSerial->print(ESP_CMD_CLOSE);
-    pSerial->println(chan);
+    SerialPrint(ESP_CMD_CLOSE);
+    SerialPrint(chan);
+    SerialPrintln();
     ReadResponse(resp_OK, 1000);
 }
 
+void Esp8266::Close()
+{
+    Disconnect(F("0"));
+}
+
 void Esp8266::print(const __FlashStringHelper *buffer)
 {
     if(status)
     {
-        if(SendHeader(strlen_P((const prog_char*)buffer)))
+        if(coalesceLvl)
+            MbTransport::print(buffer);
+        else if(SendHeader(strlen_P((const prog_char*)buffer)))
         {
-            pSerial->print(buffer);
+            SerialPrint(buffer);
             ReadResponse(resp_SendOK, 2000);
         }
     }
@@ -234,9 +273,11 @@ void Esp8266::print(int val)
 {
     if(status)
     {
-        if(SendHeader(GetIntLen(val)))
+        if(coalesceLvl)
+            MbTransport::print(val);
+        else if(SendHeader(GetIntLen(val)))
         {
-            pSerial->print(val);
+            SerialPrint(val);
             ReadResponse(resp_SendOK, 2000);
         }
     }
@@ -246,9 +287,11 @@ void Esp8266::print(double val, int digits)
 {
     if(status)
     {
-        if(SendHeader(GetIntLen((int)val) + digits + 1))
+        if(coalesceLvl)
+            MbTransport::print(val, digits);
+        else if(SendHeader(GetIntLen((int)val) + digits + 1))
         {
-            pSerial->print(val, digits);
+            SerialPrint(val, digits);
             ReadResponse(resp_SendOK, 2000);
         }
     }
@@ -258,9 +301,12 @@ void Esp8266::println(const __FlashStringHelper *buffer)
 {
     if(status)
     {
-        if(SendHeader(strlen_P((const prog_char*)buffer)+2))
+        if(coalesceLvl)
+            MbTransport::println(buffer);
+        else if(SendHeader(strlen_P((const prog_char*)buffer)+2))
         {
-            pSerial->println(buffer);
+            SerialPrint(buffer);
+            SerialPrintln();
             ReadResponse(resp_SendOK, 2000);
         }
     }
@@ -270,9 +316,12 @@ void Esp8266::println(const char *buffer)
 {
     if(status)
     {
-        if(SendHeader(strlen(buffer)+2))
+        if(coalesceLvl)
+            MbTransport::println(buffer);
+        else if(SendHeader(strlen(buffer)+2))
         {
-            pSerial->println(buffer);
+            SerialPrint(buffer);
+            SerialPrintln();
             ReadResponse(resp_SendOK, 2000);
         }
     }
@@ -282,9 +331,11 @@ void Esp8266::println()
 {
     if(status)
     {
-        if(SendHeader(2))
+        if(coalesceLvl)
+            Append((const uint8_t*)"\r\n", 2);
+        else if(SendHeader(2))
         {
-            pSerial->println();
+            SerialPrintln();
             ReadResponse(resp_SendOK, 2000);
         }
     }
@@ -296,21 +347,87 @@ void Esp8266::write(const uint8_t *buffer, size_t size)
     {
         if(size)
         {
-            if(SendHeader(size))
+            if(coalesceLvl)
+                Append(buffer, size);
+            else if(SendHeader(size))
             {
-                pSerial->write(buffer, size);
+                SerialWrite(buffer, size);
                 ReadResponse(resp_SendOK, 2000);
             }
         }
     }
 }
 
+// Output between StartCoalesce() and EndCoalesce() is collected in txBuf
+// and sent with as few CIPSENDs as possible. Calls may be nested.
+void Esp8266::StartCoalesce()
+{
+    coalesceLvl++;
+}
+
+void Esp8266::EndCoalesce()
+{
+    if(coalesceLvl)
+    {
+        coalesceLvl--;
+        if(!coalesceLvl)
+            Flush();
+    }
+}
+
+// Larger queues mean fewer CIPSENDs and fewer lost input bytes,
+// both are limited to 255 bytes by the length fields
+void Esp8266::SetBuffers(uint8_t *pTx, uint16_t txLen, uint8_t *pRx, uint16_t rxLen)
+{
+    Flush();
+    if(pTx != NULL && txLen != 0)
+    {
+        txBuf = (char*)pTx;
+        txSize = txLen > 255 ? 255 : txLen;
+    }
+    if(pRx != NULL && rxLen != 0)
+    {
+        ipdBuf = (char*)pRx;
+        ipdSize = rxLen > 255 ? 255 : rxLen;
+        ipdReadPos = 0;
+        ipdWritePos = 0;
+    }
+}
+
+void Esp8266::Flush()
+{
+    uint8_t len = txPos;
+
+    txPos = 0;
+    if(len && status)
+    {
+        if(SendHeader(len))
+        {
+            SerialWrite((uint8_t*)txBuf, len);
+            ReadResponse(resp_SendOK, 2000);
+        }
+    }
+}
+
+void Esp8266::Append(const uint8_t *buffer, size_t size)
+{
+    while(size--)
+    {
+        if(txPos >= txSize)
+            Flush();
+        txBuf[txPos++] = *buffer++;
+    }
+}
+
 bool Esp8266::SendHeader(int size)
 {
+    if(txPos)
+        Flush();
     if(size)
     {
-        pSerial->print(ESP_CMD_SEND);
-        pSerial->println(size);
+        SerialPrint(ESP_CMD_SEND);
+        SerialPrint(size);
+        SerialPrintln();
         if(ReadResponse(resp_BG, 6000))
             return true;
     }
@@ -358,3 +475,213 @@ uint8_t Esp8266::GetRecLen()
     }
     return len;
 }
+
+// All traffic with the module goes through the Serial* functions,
+// so the trace sees every byte
+int Esp8266::SerialRead()
+{
+    int ch = pSerial->read();
+
+#if MB_FEATURE_TRACE
+    if(traceActive && ch >= 0)
+        Trace(TRACE_RX, ch);
+#endif
+    return ch;
+}
+
+void Esp8266::SerialWrite(const uint8_t *buffer, size_t size)
+{
+    pSerial->write(buffer, size);
+#if MB_FEATURE_TRACE
+    if(traceActive)
+    {
+        while(size--)
+            Trace(TRACE_TX, *buffer++);
+    }
+#endif
+}
+
+void Esp8266::SerialPrint(const __FlashStringHelper *buffer)
+{
+    pSerial->print(buffer);
+#if MB_FEATURE_TRACE
+    if(traceActive)
+    {
+        const prog_char *p = (const prog_char*)buffer;
+        char ch;
+
+        while((ch = pgm_read_byte(p++)) != 0)
+            Trace(TRACE_TX, ch);
+    }
+#endif
+}
+
+void Esp8266::SerialPrint(const char *buffer)
+{
+    pSerial->print(buffer);
+#if MB_FEATURE_TRACE
+    if(traceActive)
+    {
+        while(*buffer)
+            Trace(TRACE_TX, *buffer++);
+    }
+#endif
+}
+
+void Esp8266::SerialPrint(int val)
+{
+    pSerial->print(val);
+#if MB_FEATURE_TRACE
+    if(traceActive)
+    {
+        char buf[12];
+        char *p = buf;
+
+        itoa(val, buf, 10);
+        while(*p)
+            Trace(TRACE_TX, *p++);
+    }
+#endif
+}
+
+void Esp8266::SerialPrint(double val, int digits)
+{
+    pSerial->print(val, digits);
+#if MB_FEATURE_TRACE
+    if(traceActive)
+    {
+        char buf[24];
+        char *p = buf;
+
+        // Same text as Print::print(double)
+        if(isnan(val))
+            strcpy_P(buf, PSTR("nan"));
+        else if(isinf(val))
+            strcpy_P(buf, PSTR("inf"));
+        else if(val > 4294967040.0 || val < -4294967040.0)
+            strcpy_P(buf, PSTR("ovf"));
+        else
+            dtostrf(val, 1, digits > 10 ? 10 : digits, buf);
+        while(*p)
+            Trace(TRACE_TX, *p++);
+    }
+#endif
+}
+
+void Esp8266::SerialPrintln()
+{
+    pSerial->println();
+#if MB_FEATURE_TRACE
+    if(traceActive)
+    {
+        Trace(TRACE_TX, '\r');
+        Trace(TRACE_TX, '\n');
+    }
+#endif
+}
+
+#if MB_FEATURE_TRACE
+// Ring of two byte entries, the memory stays with the caller
+void Esp8266::SetTraceBuffer(uint8_t *pBuf, uint16_t size)
+{
+    traceActive = false;
+    traceBuf = pBuf;
+    traceEntries = pBuf != NULL ? size / 2 : 0;
+    traceHead = 0;
+    traceCnt = 0;
+    traceTotal = 0;
+}
+
+void Esp8266::TraceStart()
+{
+    traceHead = 0;
+    traceCnt = 0;
+    traceTotal = 0;
+    traceLast = millis();
+    traceActive = traceEntries != 0;
+}
+
+void Esp8266::TraceStop()
+{
+    traceActive = false;
+}
+
+bool Esp8266::TraceActive()
+{
+    return traceActive;
+}
+
+uint16_t Esp8266::TraceCount()
+{
+    return traceCnt;
+}
+
+uint16_t Esp8266::TraceCapacity()
+{
+    return traceEntries;
+}
+
+uint32_t Esp8266::TraceTotal()
+{
+    return traceTotal;
+}
+
+// The first byte of an entry holds the direction in bit 7 and the ms
+// since the previous entry in bits 0..6, the second the data byte.
+// Longer gaps get a TRACE_GAP entry first, gaps above 32 s are cut.
+void Esp8266::Trace(uint8_t dir, uint8_t ch)
+{
+    unsigned long now = millis();
+    unsigned long delta = now - traceLast;
+
+    traceLast = now;
+    if(delta >= TRACE_GAP)
+    {
+        TracePut(TRACE_GAP, delta >> 7 > 255 ? 255 : delta >> 7);
+        delta &= 0x7f;
+        if(delta == TRACE_GAP)
+            delta--;
+    }
+    TracePut((dir == TRACE_RX ? 0x80 : 0) | delta, ch);
+}
+
+void Esp8266::TracePut(uint8_t flags, uint8_t ch)
+{
+    traceBuf[traceHead*2] = flags;
+    traceBuf[traceHead*2+1] = ch;
+    traceHead++;
+    if(traceHead >= traceEntries)
+        traceHead = 0;
+    if(traceCnt < traceEntries)
+        traceCnt++;
+    traceTotal++;
+}
+
+// Returns the direction of the byte at *pPos, counted from the oldest
+// entry, or 0 at the end. *pDelta is the time in ms since the byte
+// before, *pPos is moved past the byte and its gap entries.
+uint8_t Esp8266::TraceRead(uint16_t *pPos, uint16_t *pDelta, uint8_t *pCh)
+{
+    uint16_t delta = 0;
+    uint16_t i;
+    uint8_t *p;
+
+    while(*pPos < traceCnt)
+    {
+        i = *pPos + (traceCnt < traceEntries ? 0 : traceHead);
+        if(i >= traceEntries)
+            i -= traceEntries;
+        p = traceBuf + i*2;
+        (*pPos)++;
+        if((p[0] & 0x7f) == TRACE_GAP)
+            delta += (uint16_t)p[1] << 7;
+        else
+        {
+            *pDelta = delta + (p[0] & 0x7f);
+            *pCh = p[1];
+            return (p[0] & 0x80) ? TRACE_RX : TRACE_TX;
+        }
+    }
+    return 0;
+}
+#endif
@@ -4,9 +4,8 @@
 #define __PROG_TYPES_COMPAT__
 #include <Arduino.h>
 #include <avr/pgmspace.h>
-
-#define STATUS_ESP_DISCONNECTED 0
-#define STATUS_ESP_CONNECTED 1
+#include <mbTransport.h>
+#include <microBoxConfig.h>
 
 #define ESP_CMD_RESET F("AT+RST")
 #define ESP_CMD_INIT1 F("AT+CIPMUX=1")
@@ -22,11 +21,25 @@
 #define ESP_RESP_CIPSTATUS F("+CIPSTATUS:")
 
 #define ESP_REC_BUF_SIZE 20
+#ifndef ESP_IPD_BUF_SIZE
 #define ESP_IPD_BUF_SIZE 40
+#endif
+#ifndef ESP_TX_BUF_SIZE
+#define ESP_TX_BUF_SIZE 64
+#endif
+
+#if MB_FEATURE_TRACE
+#define TRACE_TX 1          // Sent to the module
+#define TRACE_RX 2          // Received from the module
+#define TRACE_GAP 0x7f      // Marker entry, gap in 128 ms units
+#endif
 
 
-class Esp8266
+class Esp8266 : public MbTransport
 {
+    friend class MbBench;   // extras/host/mbBench.cpp
+    friend class MbReplay;  // extras/host/mbReplay.cpp
+
 public:
     Esp8266();
     ~Esp8266();
@@ -34,6 +47,10 @@ public:
     void ConfigSettings(bool apMode, char *ssid, char *key);
     uint8_t GetStatus();
     void Disconnect(const __FlashStringHelper *chan);
+    void Close();
+    uint8_t Receive();
+    bool available();
+    bool IsTelnet();
 
     char read();
     void print(const __FlashStringHelper *buffer);
@@ -50,8 +67,34 @@ public:
     uint8_t ReadResponse(const prog_char *resp = NULL, unsigned long timeout = 0);
     void clearBuffer(uint8_t avail = 0);
     bool SerialAvailable();
+    void StartCoalesce();
+    void EndCoalesce();
+    void SetBuffers(uint8_t *pTx, uint16_t txLen, uint8_t *pRx, uint16_t rxLen);
+    void Flush();
+#if MB_FEATURE_TRACE
+    void SetTraceBuffer(uint8_t *pBuf, uint16_t size);
+    void TraceStart();
+    void TraceStop();
+    bool TraceActive();
+    uint16_t TraceCount();
+    uint16_t TraceCapacity();
+    uint32_t TraceTotal();
+    uint8_t TraceRead(uint16_t *pPos, uint16_t *pDelta, uint8_t *pCh);
+#endif
 
 private:
+    int SerialRead();
+    void SerialWrite(const uint8_t *buffer, size_t size);
+    void SerialPrint(const __FlashStringHelper *buffer);
+    void SerialPrint(const char *buffer);
+    void SerialPrint(int val);
+    void SerialPrint(double val, int digits);
+    void SerialPrintln();
+#if MB_FEATURE_TRACE
+    void Trace(uint8_t dir, uint8_t ch);
+    void TracePut(uint8_t flags, uint8_t ch);
+#endif
+    void Append(const uint8_t *buffer, size_t size);
     uint8_t GetRecLen();
     void SendInit(bool resetOnly=false);
     void ReadIpd(uint8_t len);
@@ -59,13 +102,29 @@ private:
 private:
     HardwareSerial *pSerial;
     char recBuf[ESP_REC_BUF_SIZE];
-    char ipdBuf[ESP_IPD_BUF_SIZE];
+    char ipdDefault[ESP_IPD_BUF_SIZE];
+    char *ipdBuf;
+    uint8_t ipdSize;
     uint8_t bufPos;
     uint8_t ipdWritePos;
     uint8_t ipdReadPos;
+    char txDefault[ESP_TX_BUF_SIZE];
+    char *txBuf;
+    uint8_t txSize;
+    uint8_t txPos;
+    uint8_t coalesceLvl;
     uint8_t status;
     int discard;
     bool initFinished;
+#if MB_FEATURE_TRACE
+    uint8_t *traceBuf;
+    uint16_t traceEntries;
+    uint16_t traceHead;
+    uint16_t traceCnt;
+    uint32_t traceTotal;
+    unsigned long traceLast;
+    bool traceActive;
+#endif
 
     const prog_char* resp_ready;
     const prog_char* resp_OK;
@@ -0,0 +1,75 @@
+/*
+  Arduino.h - Minimal Arduino API for building microBoxEsp on Linux.
+  Only what the library uses is provided.
+  Released under GPLv3.
+*/
+
+#ifndef _HOST_ARDUINO_H_
+#define _HOST_ARDUINO_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <math.h>
+#include <avr/pgmspace.h>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+class __FlashStringHelper;
+#define F(string_literal) (reinterpret_cast<const __FlashStringHelper *>(string_literal))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+char *itoa(int val, char *s, int radix);
+char *ltoa(long val, char *s, int radix);
+char *ultoa(unsigned long val, char *s, int radix);
+char *dtostrf(double val, signed char width, unsigned char prec, char *s);
+
+// Stand-in for the serial port, reads stdin and writes stdout
+class HardwareSerial
+{
+public:
+    HardwareSerial();
+    void begin(unsigned long baud);
+    // Reads come from data instead of stdin until Feed(NULL, 0)
+    void Feed(const uint8_t *data, size_t len);
+    // Like Feed(), byte i becomes readable when millis() reaches ms[i]
+    void FeedTimed(const uint8_t *data, const unsigned long *ms, size_t len);
+    // Writes go to hook instead of stdout until SetWriteHook(NULL)
+    void SetWriteHook(void (*hook)(const uint8_t *buffer, size_t size));
+    int available();
+    int read();
+    size_t write(uint8_t c);
+    size_t write(const uint8_t *buffer, size_t size);
+    size_t print(const __FlashStringHelper *s);
+    size_t print(const char *s);
+    size_t print(char c);
+    size_t print(int val);
+    size_t print(unsigned int val);
+    size_t print(long val);
+    size_t print(unsigned long val);
+    size_t print(double val, int digits = 2);
+    size_t println(const __FlashStringHelper *s);
+    size_t println(const char *s);
+    size_t println(int val);
+    size_t println(unsigned long val);
+    size_t println();
+
+private:
+    const uint8_t *pFeed;
+    const unsigned long *pFeedMs;
+    void (*pWriteHook)(const uint8_t *buffer, size_t size);
+    size_t feedLen;
+    size_t feedPos;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,19 @@
+/*
+  avr/eeprom.h - EEPROM emulated in RAM for Linux builds.
+  Released under GPLv3.
+*/
+
+#ifndef _HOST_EEPROM_H_
+#define _HOST_EEPROM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define E2END 4095
+
+void eeprom_read_block(void *dst, const void *src, size_t size);
+void eeprom_write_block(const void *src, void *dst, size_t size);
+uint8_t eeprom_read_byte(const uint8_t *addr);
+void eeprom_write_byte(uint8_t *addr, uint8_t val);
+
+#endif
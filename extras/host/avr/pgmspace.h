@@ -0,0 +1,31 @@
+/*
+  avr/pgmspace.h - Flash access macros mapped to plain memory for Linux builds.
+  Released under GPLv3.
+*/
+
+#ifndef _HOST_PGMSPACE_H_
+#define _HOST_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+typedef char prog_char;
+
+#define pgm_read_byte(p) (*(const uint8_t *)(p))
+#define pgm_read_byte_near(p) (*(const uint8_t *)(p))
+#define pgm_read_word(p) (*(const uint16_t *)(p))
+
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcat_P strcat
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strlen_P strlen
+#define strstr_P strstr
+#define strchr_P strchr
+#define memcpy_P memcpy
+
+#endif
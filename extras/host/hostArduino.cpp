@@ -0,0 +1,240 @@
+/*
+  hostArduino.cpp - Minimal Arduino API for building microBoxEsp on Linux.
+  Released under GPLv3.
+*/
+
+#include <Arduino.h>
+#include <avr/eeprom.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+
+HardwareSerial Serial;
+
+static uint8_t eeprom[E2END+1];
+
+static uint64_t monotonicUs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static uint64_t startUs = monotonicUs();
+
+unsigned long millis()
+{
+    return (unsigned long)((monotonicUs() - startUs) / 1000);
+}
+
+unsigned long micros()
+{
+    return (unsigned long)(monotonicUs() - startUs);
+}
+
+void delay(unsigned long ms)
+{
+    usleep(ms * 1000);
+}
+
+char *itoa(int val, char *s, int radix)
+{
+    if(radix == 16)
+        sprintf(s, "%x", val);
+    else
+        sprintf(s, "%d", val);
+    return s;
+}
+
+char *ltoa(long val, char *s, int radix)
+{
+    if(radix == 16)
+        sprintf(s, "%lx", val);
+    else
+        sprintf(s, "%ld", val);
+    return s;
+}
+
+char *ultoa(unsigned long val, char *s, int radix)
+{
+    if(radix == 16)
+        sprintf(s, "%lx", val);
+    else
+        sprintf(s, "%lu", val);
+    return s;
+}
+
+char *dtostrf(double val, signed char width, unsigned char prec, char *s)
+{
+    sprintf(s, "%*.*f", width, prec, val);
+    return s;
+}
+
+void eeprom_read_block(void *dst, const void *src, size_t size)
+{
+    size_t addr = (size_t)src;
+
+    if(addr + size <= sizeof(eeprom))
+        memcpy(dst, eeprom + addr, size);
+}
+
+void eeprom_write_block(const void *src, void *dst, size_t size)
+{
+    size_t addr = (size_t)dst;
+
+    if(addr + size <= sizeof(eeprom))
+        memcpy(eeprom + addr, src, size);
+}
+
+uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+    return eeprom[(size_t)addr & E2END];
+}
+
+void eeprom_write_byte(uint8_t *addr, uint8_t val)
+{
+    eeprom[(size_t)addr & E2END] = val;
+}
+
+HardwareSerial::HardwareSerial()
+{
+    Feed(NULL, 0);
+    pWriteHook = NULL;
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+}
+
+void HardwareSerial::Feed(const uint8_t *data, size_t len)
+{
+    FeedTimed(data, NULL, len);
+}
+
+void HardwareSerial::FeedTimed(const uint8_t *data, const unsigned long *ms, size_t len)
+{
+    pFeed = data;
+    pFeedMs = ms;
+    feedLen = len;
+    feedPos = 0;
+}
+
+void HardwareSerial::SetWriteHook(void (*hook)(const uint8_t *buffer, size_t size))
+{
+    pWriteHook = hook;
+}
+
+int HardwareSerial::available()
+{
+    struct pollfd pfd = {0, POLLIN, 0};
+
+    if(pFeed != NULL)
+    {
+        if(pFeedMs != NULL && feedPos < feedLen && millis() < pFeedMs[feedPos])
+            return 0;
+        return feedLen - feedPos;
+    }
+
+    return poll(&pfd, 1, 0) > 0 ? 1 : 0;
+}
+
+int HardwareSerial::read()
+{
+    uint8_t ch;
+
+    if(pFeed != NULL)
+        return available() ? pFeed[feedPos++] : -1;
+    if(::read(0, &ch, 1) == 1)
+        return ch;
+    return -1;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    return write(&c, 1);
+}
+
+size_t HardwareSerial::write(const uint8_t *buffer, size_t size)
+{
+    if(pWriteHook != NULL)
+    {
+        (*pWriteHook)(buffer, size);
+        return size;
+    }
+    return fwrite(buffer, 1, size, stdout);
+}
+
+size_t HardwareSerial::print(const __FlashStringHelper *s)
+{
+    return print((const char*)s);
+}
+
+size_t HardwareSerial::print(const char *s)
+{
+    return write((const uint8_t*)s, strlen(s));
+}
+
+size_t HardwareSerial::print(char c)
+{
+    return write((uint8_t)c);
+}
+
+size_t HardwareSerial::print(int val)
+{
+    return print((long)val);
+}
+
+size_t HardwareSerial::print(unsigned int val)
+{
+    return print((unsigned long)val);
+}
+
+size_t HardwareSerial::print(long val)
+{
+    char tmp[24];
+
+    sprintf(tmp, "%ld", val);
+    return print(tmp);
+}
+
+size_t HardwareSerial::print(unsigned long val)
+{
+    char tmp[24];
+
+    sprintf(tmp, "%lu", val);
+    return print(tmp);
+}
+
+size_t HardwareSerial::print(double val, int digits)
+{
+    char tmp[48];
+
+    snprintf(tmp, sizeof(tmp), "%.*f", digits, val);
+    return print(tmp);
+}
+
+size_t HardwareSerial::println(const __FlashStringHelper *s)
+{
+    return print(s) + println();
+}
+
+size_t HardwareSerial::println(const char *s)
+{
+    return print(s) + println();
+}
+
+size_t HardwareSerial::println(int val)
+{
+    return print(val) + println();
+}
+
+size_t HardwareSerial::println(unsigned long val)
+{
+    return print(val) + println();
+}
+
+size_t HardwareSerial::println()
+{
+    return print("\r\n");
+}
@@ -0,0 +1,310 @@
+/*
+  linuxTransport.cpp - Telnet socket transport for running microBoxEsp
+                       on Linux with many concurrent sessions.
+  Released under GPLv3.
+*/
+
+#include <linuxTransport.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define LISTEN_TAG 0xFFFFFFFF
+#define MAX_EVENTS 64
+
+LinuxTransport::LinuxTransport()
+{
+    fd = -1;
+    epollFd = -1;
+    epollTag = 0;
+    waitWritable = false;
+    released = true;
+    coalesceLvl = 0;
+    rxReadPos = 0;
+    rxWritePos = 0;
+    txLen = 0;
+}
+
+void LinuxTransport::Attach(int sockFd, int pollFd, uint32_t tag)
+{
+    struct epoll_event ev;
+
+    fd = sockFd;
+    released = false;
+    epollFd = pollFd;
+    epollTag = tag;
+    waitWritable = false;
+    coalesceLvl = 0;
+    rxReadPos = 0;
+    rxWritePos = 0;
+    txLen = 0;
+
+    ev.events = EPOLLIN;
+    ev.data.u32 = tag;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+int LinuxTransport::GetFd()
+{
+    return fd;
+}
+
+// A closed slot is reused only after the shell has seen the disconnect
+bool LinuxTransport::IsFree()
+{
+    return fd == -1 && released;
+}
+
+bool LinuxTransport::OnReadable()
+{
+    ssize_t len;
+
+    if(rxReadPos == rxWritePos)
+    {
+        rxReadPos = 0;
+        rxWritePos = 0;
+    }
+    if(rxWritePos == LINUX_RX_BUF_SIZE)
+        return true;
+
+    len = recv(fd, rxBuf + rxWritePos, LINUX_RX_BUF_SIZE - rxWritePos, 0);
+    if(len > 0)
+    {
+        rxWritePos += len;
+        return true;
+    }
+    if(len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))
+        return true;
+
+    Close();
+    return false;
+}
+
+bool LinuxTransport::OnWritable()
+{
+    Flush();
+    return fd != -1;
+}
+
+uint8_t LinuxTransport::GetStatus()
+{
+    if(fd == -1)
+    {
+        released = true;
+        return STATUS_ESP_DISCONNECTED;
+    }
+    return STATUS_ESP_CONNECTED;
+}
+
+void LinuxTransport::Close()
+{
+    if(fd != -1)
+        Flush();
+    if(fd != -1)
+    {
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+        close(fd);
+        fd = -1;
+    }
+    rxReadPos = 0;
+    rxWritePos = 0;
+    txLen = 0;
+}
+
+uint8_t LinuxTransport::Receive()
+{
+    uint16_t avail = rxWritePos - rxReadPos;
+
+    return avail > 255 ? 255 : avail;
+}
+
+char LinuxTransport::read()
+{
+    if(rxReadPos < rxWritePos)
+        return rxBuf[rxReadPos++];
+    return -1;
+}
+
+bool LinuxTransport::available()
+{
+    return rxReadPos < rxWritePos;
+}
+
+void LinuxTransport::clearBuffer(uint8_t avail)
+{
+    rxReadPos = 0;
+    rxWritePos = 0;
+}
+
+void LinuxTransport::write(const uint8_t *buffer, size_t size)
+{
+    if(fd == -1)
+        return;
+
+    if(txLen + size > LINUX_TX_BUF_SIZE)
+    {
+        Flush();
+        if(txLen + size > LINUX_TX_BUF_SIZE)
+        {
+            // Client does not read its output, give up on it
+            txLen = 0;
+            Close();
+            return;
+        }
+    }
+    memcpy(txBuf + txLen, buffer, size);
+    txLen += size;
+    if(!coalesceLvl)
+        Flush();
+}
+
+bool LinuxTransport::IsTelnet()
+{
+    return true;
+}
+
+void LinuxTransport::StartCoalesce()
+{
+    coalesceLvl++;
+}
+
+void LinuxTransport::EndCoalesce()
+{
+    if(coalesceLvl)
+    {
+        coalesceLvl--;
+        if(!coalesceLvl)
+            Flush();
+    }
+}
+
+void LinuxTransport::Flush()
+{
+    ssize_t len;
+
+    if(fd == -1 || txLen == 0)
+        return;
+
+    len = send(fd, txBuf, txLen, MSG_NOSIGNAL);
+    if(len > 0)
+    {
+        txLen -= len;
+        memmove(txBuf, txBuf + len, txLen);
+    }
+    else if(len < 0 && errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+    {
+        txLen = 0;
+        Close();
+        return;
+    }
+    WatchWritable(txLen != 0);
+}
+
+void LinuxTransport::WatchWritable(bool on)
+{
+    struct epoll_event ev;
+
+    if(on == waitWritable)
+        return;
+
+    waitWritable = on;
+    ev.events = on ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.u32 = epollTag;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+LinuxServer::LinuxServer()
+{
+    listenFd = -1;
+    epollFd = -1;
+    sessions = NULL;
+    sessionNum = 0;
+}
+
+bool LinuxServer::begin(uint16_t port, LinuxTransport *pSessions, uint16_t sessionCnt)
+{
+    struct sockaddr_in addr;
+    struct epoll_event ev;
+    int on = 1;
+
+    sessions = pSessions;
+    sessionNum = sessionCnt;
+
+    listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if(listenFd < 0)
+        return false;
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    addr.sin_port = htons(port);
+    if(bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 128) < 0)
+        return false;
+
+    epollFd = epoll_create1(0);
+    if(epollFd < 0)
+        return false;
+
+    ev.events = EPOLLIN;
+    ev.data.u32 = LISTEN_TAG;
+    return epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) == 0;
+}
+
+void LinuxServer::Accept()
+{
+    int fd;
+    int on = 1;
+    uint16_t i;
+
+    while((fd = accept4(listenFd, NULL, NULL, SOCK_NONBLOCK)) >= 0)
+    {
+        for(i=0;i<sessionNum;i++)
+        {
+            if(sessions[i].IsFree())
+                break;
+        }
+        if(i == sessionNum)
+        {
+            close(fd);
+            continue;
+        }
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        sessions[i].Attach(fd, epollFd, i);
+    }
+}
+
+// Waits for socket activity and moves data between the sockets and
+// the session buffers, returns the number of events handled.
+int LinuxServer::Poll(int timeoutMs)
+{
+    struct epoll_event events[MAX_EVENTS];
+    int cnt;
+    int i;
+
+    cnt = epoll_wait(epollFd, events, MAX_EVENTS, timeoutMs);
+    for(i=0;i<cnt;i++)
+    {
+        uint32_t tag = events[i].data.u32;
+
+        if(tag == LISTEN_TAG)
+        {
+            Accept();
+            continue;
+        }
+        if(tag >= sessionNum)
+            continue;
+        if(events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR))
+        {
+            if(!sessions[tag].OnReadable())
+                continue;
+        }
+        if(events[i].events & EPOLLOUT)
+            sessions[tag].OnWritable();
+    }
+    return cnt;
+}
@@ -0,0 +1,74 @@
+/*
+  linuxTransport.h - Telnet socket transport for running microBoxEsp
+                     on Linux with many concurrent sessions.
+  Released under GPLv3.
+*/
+
+#ifndef _LINUXTRANSPORT_H_
+#define _LINUXTRANSPORT_H_
+
+#include <mbTransport.h>
+
+#define LINUX_RX_BUF_SIZE 512
+#define LINUX_TX_BUF_SIZE 16384
+
+// One client connection. Output is queued and sent non-blocking,
+// a client that does not drain its queue is disconnected.
+class LinuxTransport : public MbTransport
+{
+public:
+    LinuxTransport();
+    void Attach(int sockFd, int pollFd, uint32_t tag);
+    int GetFd();
+    bool IsFree();
+    bool OnReadable();
+    bool OnWritable();
+
+    uint8_t GetStatus();
+    void Close();
+    uint8_t Receive();
+    char read();
+    bool available();
+    void clearBuffer(uint8_t avail = 0);
+    void write(const uint8_t *buffer, size_t size);
+    bool IsTelnet();
+    void StartCoalesce();
+    void EndCoalesce();
+
+private:
+    void Flush();
+    void WatchWritable(bool on);
+
+private:
+    int fd;
+    int epollFd;
+    uint32_t epollTag;
+    bool waitWritable;
+    bool released;
+    uint8_t coalesceLvl;
+    char rxBuf[LINUX_RX_BUF_SIZE];
+    uint16_t rxReadPos;
+    uint16_t rxWritePos;
+    char txBuf[LINUX_TX_BUF_SIZE];
+    uint16_t txLen;
+};
+
+// Listening socket and epoll loop feeding an array of transports
+class LinuxServer
+{
+public:
+    LinuxServer();
+    bool begin(uint16_t port, LinuxTransport *pSessions, uint16_t sessionCnt);
+    int Poll(int timeoutMs);
+
+private:
+    void Accept();
+
+private:
+    int listenFd;
+    int epollFd;
+    LinuxTransport *sessions;
+    uint16_t sessionNum;
+};
+
+#endif
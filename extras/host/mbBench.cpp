@@ -0,0 +1,414 @@
+/*
+  mbBench.cpp - Microbenchmarks of the shell's hot functions.
+  Runs parameter lookup, tab completion, command dispatch, tokenizer,
+  history, number parsing and the esp8266 response parser against
+  parameter tables of 10, 100 and 1000 entries, and checks that doubles
+  survive a dump and load, and that a dumped line longer than the line
+  buffer is rejected by load instead of applied cut off. Every result is
+  printed as one line of key=value pairs.
+
+  Usage: mbBench [min_ms]
+  Released under GPLv3.
+*/
+
+#include <microBoxEsp.h>
+#include <time.h>
+
+#define DEFAULT_MIN_MS 200
+#define HISTORY_SIZE 1024
+#define DUMP_ARENA_SIZE 512
+#define GROUP_SIZE 10
+
+class NullTransport : public MbTransport
+{
+public:
+    uint8_t GetStatus() { return STATUS_ESP_CONNECTED; }
+    void Close() {}
+    uint8_t Receive() { return 0; }
+    char read() { return -1; }
+    bool available() { return false; }
+    void clearBuffer(uint8_t avail) {}
+    void write(const uint8_t *buffer, size_t size) { bytes += size; }
+
+    size_t bytes;
+};
+
+// Keeps the output for the dump/load round trip and feeds it back
+class CaptureTransport : public NullTransport
+{
+public:
+    uint8_t Receive() { return inLen - inPos > 255 ? 255 : inLen - inPos; }
+    char read() { return inPos < inLen ? in[inPos++] : -1; }
+    bool available() { return inPos < inLen; }
+    void write(const uint8_t *buffer, size_t size)
+    {
+        if(len + size < sizeof(line))
+        {
+            memcpy(line + len, buffer, size);
+            len += size;
+            line[len] = 0;
+        }
+    }
+
+    char line[256];
+    size_t len;
+    char in[256];
+    size_t inPos;
+    size_t inLen;
+};
+
+class MbBench
+{
+public:
+    static void Run(const char *name, uint16_t entries, void (*func)(uint32_t i));
+    static void Init(uint32_t minMs);
+    static bool Setup(uint16_t entries);
+    static void Cleanup();
+
+    static void GetParamIdx(uint32_t i);
+    static void ResolvePath(uint32_t i);
+    static void HandleTab(uint32_t i);
+    static void ExecLine(uint32_t i);
+    static void ParseCmdParams(uint32_t i);
+    static void History(uint32_t i);
+    static void ParseFloat(uint32_t i);
+    static void DumpLoad(uint32_t i);
+    static void LoadLong(uint32_t i);
+    static void ReadResponse(uint32_t i);
+    static void Nop(char **pParam, uint8_t parCnt);
+
+    static microBoxEsp *shell;
+    static Esp8266 *esp;
+    static NullTransport transport;
+    static microBoxEsp *dumpShell;
+    static CaptureTransport capture;
+    static PARAM_ENTRY *params;
+    static char (*paths)[24];
+    static uint16_t entries;
+    static bool ok;
+    static uint32_t minUs;
+};
+
+microBoxEsp *MbBench::shell;
+Esp8266 *MbBench::esp;
+NullTransport MbBench::transport;
+microBoxEsp *MbBench::dumpShell;
+CaptureTransport MbBench::capture;
+PARAM_ENTRY *MbBench::params;
+char (*MbBench::paths)[24];
+uint16_t MbBench::entries;
+bool MbBench::ok;
+uint32_t MbBench::minUs;
+
+static uint8_t *arena;
+static uint8_t dumpArena[DUMP_ARENA_SIZE];
+static int value;
+static double dumpValue;
+static double dumpArray[5];
+static PARAM_ENTRY dumpParams[] =
+{
+    {"a", dumpArray, PARTYPE_DOUBLE | PARTYPE_ARRAY | PARTYPE_RW, 5, NULL, NULL, 0},
+    {"d", &dumpValue, PARTYPE_DOUBLE | PARTYPE_RW, 0, NULL, NULL, 0},
+    {NULL, NULL}
+};
+static const char ipdFrame[] = "\r\n+IPD,0,18:cat /dev/g000/a0\r\n";
+
+static uint64_t nowNs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Doubles the iteration count until the run takes at least minUs
+void MbBench::Run(const char *name, uint16_t entries, void (*func)(uint32_t i))
+{
+    uint64_t start, ns = 0;
+    uint32_t iters = 1;
+    uint32_t i;
+
+    ok = true;
+    while(true)
+    {
+        start = nowNs();
+        for(i=0;i<iters;i++)
+            (*func)(i);
+        ns = nowNs() - start;
+        if(ns >= minUs * 1000ULL || iters >= 0x40000000UL)
+            break;
+        iters *= 2;
+    }
+    printf("bench=%s entries=%u iters=%u ns_per_op=%.1f ok=%d\n", name, entries, iters, (double)ns / iters, ok ? 1 : 0);
+    fflush(stdout);
+}
+
+// The esp8266 parser reads from Serial, which is fed from memory
+void MbBench::Init(uint32_t minMs)
+{
+    minUs = minMs * 1000UL;
+    esp = &esp8266;
+    esp->pSerial = &Serial;
+    esp->initFinished = false;
+
+    dumpShell = new microBoxEsp;
+    dumpShell->begin(dumpParams, "bench", "bench", dumpArena, sizeof(dumpArena), &capture);
+}
+
+// Parameters g000/a0000, g000/b0001 .. in groups of GROUP_SIZE,
+// the first letter is unique within a group for HandleTab
+bool MbBench::Setup(uint16_t cnt)
+{
+    const MB_LIMITS limits = {128, 16, 0, 0, 0};
+    uint16_t arenaSize;
+    char name[16];
+    uint16_t i;
+
+    entries = cnt;
+    params = new PARAM_ENTRY[cnt+1];
+    paths = new char[cnt][24];
+    memset(params, 0, (cnt+1) * sizeof(PARAM_ENTRY));
+    for(i=0;i<cnt;i++)
+    {
+        snprintf(name, sizeof(name), "g%03u/%c%04u", i / GROUP_SIZE, 'a' + i % GROUP_SIZE, i);
+        snprintf(paths[i], sizeof(paths[i]), "/dev/%s", name);
+        params[i].paramName = strdup(name);
+        params[i].pParam = &value;
+        params[i].parType = PARTYPE_INT | PARTYPE_RW;
+    }
+
+    arenaSize = microBoxEsp::ArenaSize(params, &limits) + HISTORY_SIZE;
+    arena = new uint8_t[arenaSize];
+    shell = new microBoxEsp;
+    if(!shell->begin(params, "bench", "bench", arena, arenaSize, &transport, &limits))
+        return false;
+    microBoxEsp::pActive = shell;
+    shell->loginState = STATE_LOGIN_LOGGEDIN;
+    return true;
+}
+
+void MbBench::Cleanup()
+{
+    uint16_t i;
+
+    delete shell;
+    delete[] arena;
+    for(i=0;i<entries;i++)
+        free((void*)params[i].paramName);
+    delete[] params;
+    delete[] paths;
+}
+
+void MbBench::GetParamIdx(uint32_t i)
+{
+    uint16_t idx = i % entries;
+
+    if(shell->GetParamIdx(paths[idx]) != idx)
+        ok = false;
+}
+
+// Directory lookup, what GetDir() did before the node tree
+void MbBench::ResolvePath(uint32_t i)
+{
+    uint16_t idx = i % entries;
+
+    if(shell->ResolvePath(NODE_ROOT, paths[idx], 9) < 0)
+        ok = false;
+}
+
+// Completes a parameter name from its first letter
+void MbBench::HandleTab(uint32_t i)
+{
+    uint16_t idx = i % entries;
+
+    strcpy(shell->cmdBuf, "cat ");
+    strcat(shell->cmdBuf, paths[idx]);
+    shell->bufPos = strlen(shell->cmdBuf) - 4;
+    shell->cmdBuf[shell->bufPos] = 0;
+#if MB_FEATURE_COMPLETION
+    shell->tabPressed = false;
+    shell->HandleTab();
+    if(strcmp(shell->cmdBuf+4, paths[idx]) != 0)
+        ok = false;
+#else
+    ok = false;
+#endif
+}
+
+void MbBench::ExecLine(uint32_t i)
+{
+    strcpy(shell->cmdBuf, "nop a b c");
+    if(!shell->ExecLine(shell->cmdBuf))
+        ok = false;
+}
+
+void MbBench::ParseCmdParams(uint32_t i)
+{
+    strcpy(shell->cmdBuf, "a \"b c\" d\\ e 1.5 > /dev/g000/b0001");
+    if(shell->ParseCmdParams(shell->cmdBuf) != 6)
+        ok = false;
+}
+
+void MbBench::History(uint32_t i)
+{
+#if MB_FEATURE_HISTORY
+    shell->AddToHistory(paths[i % entries]);
+    shell->historyCursorPos = -1;
+    shell->bufPos = 0;
+    shell->HistoryUp();
+    if(strcmp(shell->cmdBuf, paths[i % entries]) != 0)
+        ok = false;
+#else
+    ok = false;
+#endif
+}
+
+void MbBench::ParseFloat(uint32_t i)
+{
+    char buf[] = "-1234.5678";
+
+    if(shell->parseFloat(buf) > -1234.0)
+        ok = false;
+}
+
+// dump prints 8 fraction digits, load has to read them back without
+// overflowing on the digits
+void MbBench::DumpLoad(uint32_t i)
+{
+#if MB_FEATURE_DUMPLOAD
+    static const double values[] = {40.0, -21.5, 0.125, 4000000000.5};
+    double val = values[i % (sizeof(values)/sizeof(values[0]))];
+    char *pLine;
+
+    microBoxEsp::pActive = dumpShell;
+    dumpShell->streamState = 0;
+    capture.len = 0;
+    dumpValue = val;
+    dumpShell->Dump(NULL, 0);
+    // The last line is the one of d
+    pLine = strstr(capture.line, "\nd=");
+    if(capture.len < 2 || pLine == NULL)
+        ok = false;
+    else
+    {
+        capture.line[capture.len-2] = 0;
+        dumpValue = 0;
+        if(!dumpShell->LoadLine(pLine + 1) || fabs(dumpValue - val) > fabs(val) * 1e-12)
+            ok = false;
+    }
+    microBoxEsp::pActive = shell;
+#else
+    ok = false;
+#endif
+}
+
+// The dump of a 5 element array is longer than the default line buffer
+// of MAX_CMD_BUF_SIZE. Fed back through load it has to be counted as an
+// error and leave the array as it was, not write the values before the
+// cut and zeros behind it.
+void MbBench::LoadLong(uint32_t i)
+{
+#if MB_FEATURE_DUMPLOAD
+    const double values[] = {1.5, 2.5, 3.5, 4.5, 5.5};
+    uint8_t j;
+
+    microBoxEsp::pActive = dumpShell;
+    memcpy(dumpArray, values, sizeof(dumpArray));
+    dumpValue = 40.0 + (i & 7);
+    dumpShell->streamState = 0;
+    capture.len = 0;
+    dumpShell->Dump(NULL, 0);
+    if(capture.len + 2 >= sizeof(capture.in) || strlen(capture.line) < MAX_CMD_BUF_SIZE)
+    {
+        ok = false;
+        microBoxEsp::pActive = shell;
+        return;
+    }
+    // Dump lines end in "\r\n", an empty line ends load
+    memcpy(capture.in, capture.line, capture.len);
+    memcpy(capture.in + capture.len, "\n", 1);
+    capture.inLen = capture.len + 1;
+    capture.inPos = 0;
+
+    for(j=0;j<5;j++)
+        dumpArray[j] = 9.0;
+    dumpValue = 0;
+    dumpShell->loginState = STATE_LOGIN_LOGGEDIN;
+    dumpShell->Load(NULL, 0);
+    while(capture.available() || dumpShell->loadMode)
+    {
+        capture.len = 0;
+        dumpShell->cmdParser();
+        if(!capture.available() && dumpShell->loadMode)
+            break;
+    }
+    if(dumpShell->loadMode || dumpShell->loadErrors != 1 || dumpShell->loadCnt != 1 || dumpValue != 40.0 + (i & 7))
+        ok = false;
+    for(j=0;j<5;j++)
+    {
+        if(dumpArray[j] != 9.0)
+            ok = false;
+    }
+    microBoxEsp::pActive = shell;
+#else
+    ok = false;
+#endif
+}
+
+// One +IPD frame through the AT response parser and read()
+void MbBench::ReadResponse(uint32_t i)
+{
+    uint8_t len;
+
+    Serial.Feed((const uint8_t*)ipdFrame, sizeof(ipdFrame)-1);
+    len = esp->ReadResponse();
+    if(len != 18)
+        ok = false;
+    while(len--)
+        esp->read();
+}
+
+void MbBench::Nop(char **pParam, uint8_t parCnt)
+{
+    if(parCnt != 3)
+        shell->cmdError = true;
+}
+
+int main(int argc, char **argv)
+{
+    const uint16_t sizes[] = {10, 100, 1000};
+    uint8_t i;
+
+    uint32_t minMs = DEFAULT_MIN_MS;
+
+    if(argc > 1)
+        minMs = atol(argv[1]);
+    MbBench::Init(minMs);
+
+    for(i=0;i<sizeof(sizes)/sizeof(sizes[0]);i++)
+    {
+        if(!MbBench::Setup(sizes[i]))
+        {
+            fprintf(stderr, "mbBench: setup of %u entries failed\n", sizes[i]);
+            return 1;
+        }
+        if(i == 0)
+            MbBench::shell->AddCommand("nop", MbBench::Nop);
+        MbBench::Run("GetParamIdx", sizes[i], MbBench::GetParamIdx);
+        MbBench::Run("ResolvePath", sizes[i], MbBench::ResolvePath);
+        MbBench::Run("HandleTab", sizes[i], MbBench::HandleTab);
+        MbBench::Run("ExecLine", sizes[i], MbBench::ExecLine);
+        MbBench::Run("History", sizes[i], MbBench::History);
+        if(i == 0)
+        {
+            MbBench::Run("ParseCmdParams", 0, MbBench::ParseCmdParams);
+            MbBench::Run("parseFloat", 0, MbBench::ParseFloat);
+            MbBench::Run("DumpLoad", 0, MbBench::DumpLoad);
+            MbBench::Run("LoadLong", 0, MbBench::LoadLong);
+            MbBench::Run("ReadResponse", 0, MbBench::ReadResponse);
+        }
+        MbBench::Cleanup();
+    }
+    Serial.Feed(NULL, 0);
+    return 0;
+}
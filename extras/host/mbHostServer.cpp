@@ -0,0 +1,92 @@
+/*
+  mbHostServer.cpp - Runs microBoxEsp as a telnet server on Linux.
+  Every client gets its own shell session on the same parameter table.
+
+  Usage: mbHostServer [port [sessions]]
+  Released under GPLv3.
+*/
+
+#include <microBoxEsp.h>
+#include <linuxTransport.h>
+
+#define DEFAULT_PORT 2323
+#define DEFAULT_SESSIONS 64
+#define HISTORY_SIZE 256
+#define TMP_SIZE 4096
+
+char hostname[] = "hostBox";
+char password[] = "password";
+
+int counter = 0;
+int setpoint = 40;
+double gain = 1.5;
+double temp = 21.0;
+char label[16] = "host";
+#if MB_FEATURE_TMPFS
+uint8_t tmpBuf[TMP_SIZE];
+#endif
+
+void GetCounter(uint8_t id)
+{
+    counter++;
+}
+
+void GetTemp(uint8_t id)
+{
+    temp = 21.0 + (millis() % 1000) / 1000.0;
+}
+
+PARAM_ENTRY Params[]=
+{
+    {"counter", &counter, PARTYPE_INT | PARTYPE_RO, 0, NULL, GetCounter, 0},
+    {"gain", &gain, PARTYPE_DOUBLE | PARTYPE_RW, 0, NULL, NULL, 0},
+    {"hostname", hostname, PARTYPE_STRING | PARTYPE_RO, sizeof(hostname), NULL, NULL, 0},
+    {"label", label, PARTYPE_STRING | PARTYPE_RW, sizeof(label), NULL, NULL, 0},
+    {"setpoint", &setpoint, PARTYPE_INT | PARTYPE_RW, 0, NULL, NULL, 0},
+    {"temp", &temp, PARTYPE_DOUBLE | PARTYPE_RO, 0, NULL, GetTemp, 0},
+    {NULL, NULL}
+};
+
+int main(int argc, char **argv)
+{
+    uint16_t port = DEFAULT_PORT;
+    uint16_t sessionCnt = DEFAULT_SESSIONS;
+    LinuxTransport *transports;
+    microBoxEsp *shells;
+    uint8_t *arena;
+    LinuxServer server;
+    const MB_LIMITS limits = {128, 16, 0, 0, 0};
+    uint16_t arenaSize = microBoxEsp::ArenaSize(Params, &limits) + HISTORY_SIZE;
+    uint16_t i;
+
+    if(argc > 1)
+        port = atoi(argv[1]);
+    if(argc > 2)
+        sessionCnt = atoi(argv[2]);
+
+    transports = new LinuxTransport[sessionCnt];
+    shells = new microBoxEsp[sessionCnt];
+    arena = new uint8_t[sessionCnt * arenaSize];
+
+    if(!server.begin(port, transports, sessionCnt))
+    {
+        perror("mbHostServer");
+        return 1;
+    }
+#if MB_FEATURE_TMPFS
+    microBoxEsp::SetTmpBuffer(tmpBuf, sizeof(tmpBuf));
+#endif
+    for(i=0;i<sessionCnt;i++)
+        shells[i].begin(Params, hostname, password, arena + i*arenaSize, arenaSize, &transports[i], &limits);
+
+    printf("mbHostServer: port %u, %u sessions\n", port, sessionCnt);
+    fflush(stdout);
+
+    while(true)
+    {
+        server.Poll(1);
+        for(i=0;i<sessionCnt;i++)
+            shells[i].cmdParser();
+    }
+    return 0;
+}
@@ -0,0 +1,375 @@
+/*
+  mbLoadGen.cpp - Load generator for microBoxEsp telnet sessions.
+  Opens a number of clients, logs in and replays a script of shell
+  commands on every client. Reports commands per second and latency
+  percentiles as one key=value line. Clients the server closed before
+  the login (rejected) or before the script was done (disconnected)
+  make the exit code non-zero, like clients that timed out.
+
+  Usage: mbLoadGen host port clients rounds scriptfile [password]
+  Released under GPLv3.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#define TELNET_IAC  255
+#define TELNET_DONT 254
+#define TELNET_DO   253
+#define TELNET_WONT 252
+#define TELNET_WILL 251
+#define TELNET_SB   250
+#define TELNET_SE   240
+
+#define TELNET_OPT_ECHO     1
+#define TELNET_OPT_SGA      3
+#define TELNET_OPT_LINEMODE 34
+
+#define STATE_LOGIN    0
+#define STATE_PASSWORD 1
+#define STATE_PROMPT   2
+#define STATE_COMMAND  3
+#define STATE_DONE     4
+#define STATE_CLOSED   5    // Closed by the server or a failed send
+
+#define IDLE_TIMEOUT_US 10000000
+
+typedef struct
+{
+    int fd;
+    uint8_t state;
+    uint8_t iacState;
+    uint8_t iacCmd;
+    std::string rx;
+    size_t line;
+    int round;
+    uint64_t sendTime;
+    bool loggedIn;
+}CLIENT;
+
+static std::vector<std::string> script;
+static std::vector<uint32_t> latencies;
+static const char *password = "password";
+static int rounds = 1;
+static uint64_t firstCommand = 0;
+
+static uint64_t NowUs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void SendLine(CLIENT *c, const std::string &line)
+{
+    std::string out = line + "\r\n";
+
+    c->rx.clear();
+    c->sendTime = NowUs();
+    if(send(c->fd, out.data(), out.size(), MSG_NOSIGNAL) != (ssize_t)out.size())
+        c->state = STATE_CLOSED;
+}
+
+// Accepts linemode so the server neither echoes nor waits for single keys
+static void TelnetReply(CLIENT *c, uint8_t cmd, uint8_t opt)
+{
+    uint8_t reply[3] = {TELNET_IAC, 0, opt};
+
+    if(cmd == TELNET_DO)
+        reply[1] = (opt == TELNET_OPT_LINEMODE) ? TELNET_WILL : TELNET_WONT;
+    else if(cmd == TELNET_WILL)
+        reply[1] = (opt == TELNET_OPT_ECHO || opt == TELNET_OPT_SGA) ? TELNET_DO : TELNET_DONT;
+    else
+        return;
+    send(c->fd, reply, sizeof(reply), MSG_NOSIGNAL);
+}
+
+static void StripTelnet(CLIENT *c, const uint8_t *buf, ssize_t len)
+{
+    ssize_t i;
+
+    for(i=0;i<len;i++)
+    {
+        uint8_t ch = buf[i];
+
+        switch(c->iacState)
+        {
+        case 0:
+            if(ch == TELNET_IAC)
+                c->iacState = 1;
+            else
+                c->rx += (char)ch;
+            break;
+        case 1:
+            if(ch == TELNET_SB)
+                c->iacState = 3;
+            else if(ch >= TELNET_WILL && ch <= TELNET_DONT)
+            {
+                c->iacCmd = ch;
+                c->iacState = 2;
+            }
+            else
+            {
+                if(ch == TELNET_IAC)
+                    c->rx += (char)ch;
+                c->iacState = 0;
+            }
+            break;
+        case 2:
+            TelnetReply(c, c->iacCmd, ch);
+            c->iacState = 0;
+            break;
+        case 3:
+            if(ch == TELNET_IAC)
+                c->iacState = 4;
+            break;
+        case 4:
+            c->iacState = (ch == TELNET_SE) ? 0 : 3;
+            break;
+        }
+    }
+}
+
+static bool EndsWith(const std::string &s, const char *end)
+{
+    size_t len = strlen(end);
+
+    return s.size() >= len && s.compare(s.size() - len, len, end) == 0;
+}
+
+static bool PromptReceived(const std::string &s)
+{
+    size_t pos;
+
+    if(s.empty() || s[s.size()-1] != '>')
+        return false;
+    pos = s.rfind('\n');
+    pos = (pos == std::string::npos) ? 0 : pos + 1;
+    return s.compare(pos, 5, "root@") == 0;
+}
+
+static void NextCommand(CLIENT *c)
+{
+    if(c->line == script.size())
+    {
+        c->line = 0;
+        c->round++;
+    }
+    if(c->round == rounds)
+    {
+        c->state = STATE_DONE;
+        return;
+    }
+    c->state = STATE_COMMAND;
+    c->loggedIn = true;
+    SendLine(c, script[c->line++]);
+    if(firstCommand == 0)
+        firstCommand = c->sendTime;
+}
+
+static void Progress(CLIENT *c)
+{
+    switch(c->state)
+    {
+    case STATE_LOGIN:
+        if(EndsWith(c->rx, "login: "))
+        {
+            c->state = STATE_PASSWORD;
+            SendLine(c, "root");
+        }
+        break;
+    case STATE_PASSWORD:
+        if(EndsWith(c->rx, "Password:"))
+        {
+            c->state = STATE_PROMPT;
+            SendLine(c, password);
+        }
+        break;
+    case STATE_PROMPT:
+        if(PromptReceived(c->rx))
+            NextCommand(c);
+        break;
+    case STATE_COMMAND:
+        if(PromptReceived(c->rx))
+        {
+            latencies.push_back((uint32_t)(NowUs() - c->sendTime));
+            NextCommand(c);
+        }
+        break;
+    }
+}
+
+static int Connect(const char *host, const char *port)
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    int fd;
+    int on = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host, port, &hints, &res) != 0)
+        return -1;
+
+    fd = socket(res->ai_family, res->ai_socktype, 0);
+    if(fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) != 0)
+    {
+        close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(res);
+    if(fd >= 0)
+    {
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    }
+    return fd;
+}
+
+static bool LoadScript(const char *fileName)
+{
+    FILE *f = fopen(fileName, "r");
+    char line[256];
+
+    if(f == NULL)
+        return false;
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = 0;
+        if(line[0] != 0 && line[0] != '#')
+            script.push_back(line);
+    }
+    fclose(f);
+    return !script.empty();
+}
+
+static uint32_t Percentile(double p)
+{
+    size_t idx = (size_t)(p * (latencies.size() - 1) + 0.5);
+
+    return latencies.empty() ? 0 : latencies[idx];
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<CLIENT> clients;
+    struct epoll_event events[64];
+    int clientCnt;
+    int epollFd;
+    int active;
+    int connected = 0;
+    int rejected = 0;
+    int disconnected = 0;
+    int i;
+    uint64_t start;
+    uint64_t lastActivity;
+    double seconds;
+
+    if(argc < 6)
+    {
+        fprintf(stderr, "Usage: %s host port clients rounds scriptfile [password]\n", argv[0]);
+        return 1;
+    }
+    clientCnt = atoi(argv[3]);
+    rounds = atoi(argv[4]);
+    if(argc > 6)
+        password = argv[6];
+    if(!LoadScript(argv[5]))
+    {
+        fprintf(stderr, "mbLoadGen: cannot read script %s\n", argv[5]);
+        return 1;
+    }
+
+    epollFd = epoll_create1(0);
+    clients.resize(clientCnt);
+    for(i=0;i<clientCnt;i++)
+    {
+        struct epoll_event ev;
+        CLIENT *c = &clients[i];
+
+        c->fd = Connect(argv[1], argv[2]);
+        if(c->fd < 0)
+        {
+            fprintf(stderr, "mbLoadGen: connect failed for client %d\n", i);
+            return 1;
+        }
+        c->state = STATE_LOGIN;
+        c->iacState = 0;
+        c->line = 0;
+        c->round = 0;
+        c->loggedIn = false;
+        ev.events = EPOLLIN;
+        ev.data.u32 = i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, c->fd, &ev);
+    }
+
+    start = NowUs();
+    lastActivity = start;
+    active = clientCnt;
+    while(active > 0 && NowUs() - lastActivity < IDLE_TIMEOUT_US)
+    {
+        int cnt = epoll_wait(epollFd, events, 64, 100);
+
+        for(i=0;i<cnt;i++)
+        {
+            CLIENT *c = &clients[events[i].data.u32];
+            uint8_t buf[4096];
+            ssize_t len;
+
+            while((len = recv(c->fd, buf, sizeof(buf), 0)) > 0)
+                StripTelnet(c, buf, len);
+            if(len == 0 || (len < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+                c->state = STATE_CLOSED;
+            else
+                Progress(c);
+
+            if(c->state == STATE_CLOSED)
+            {
+                if(c->loggedIn)
+                    disconnected++;
+                else
+                    rejected++;
+            }
+            if(c->state == STATE_DONE || c->state == STATE_CLOSED)
+            {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, c->fd, NULL);
+                close(c->fd);
+                active--;
+            }
+            lastActivity = NowUs();
+        }
+    }
+    for(i=0;i<clientCnt;i++)
+    {
+        if(clients[i].loggedIn)
+            connected++;
+    }
+    // Logins are not part of the measurement
+    if(firstCommand != 0)
+        start = firstCommand;
+    seconds = (NowUs() - start) / 1e6;
+
+    std::sort(latencies.begin(), latencies.end());
+    printf("clients=%d connected=%d rejected=%d disconnected=%d commands=%zu seconds=%.3f cmds_per_sec=%.1f "
+           "p50_us=%u p90_us=%u p99_us=%u max_us=%u timeouts=%d\n",
+           clientCnt, connected, rejected, disconnected, latencies.size(), seconds, latencies.size() / seconds,
+           Percentile(0.5), Percentile(0.9), Percentile(0.99),
+           latencies.empty() ? 0 : latencies.back(), active);
+    return (active || rejected || disconnected) ? 2 : 0;
+}
@@ -0,0 +1,307 @@
+/*
+  mbReplay.cpp - Replays a trace recorded on the device with trace dump.
+  The bytes the esp8266 module sent are fed to Serial at their recorded
+  times, an Esp8266 driver with a logged in shell session reacts to them.
+  What the library sends to the module is compared with the recorded
+  traffic. The result is printed as one line of key=value pairs.
+
+  Usage: mbReplay trace.txt [-c]
+  -c starts the session in telnet character mode instead of linemode.
+  Released under GPLv3.
+*/
+
+#include <microBoxEsp.h>
+#include <vector>
+#include <algorithm>
+
+#define ARENA_SIZE 1024
+#define TAIL_MS 7000        // Longer than the driver waits for '>'
+#define STALL_MS 100
+#define CONTEXT 24
+
+char hostname[] = "hostBox";
+char password[] = "password";
+
+int counter = 0;
+int setpoint = 40;
+double gain = 1.5;
+double temp = 21.0;
+char label[16] = "host";
+
+// Same table as mbHostServer, link the application's table instead
+// when its output has to match the trace
+PARAM_ENTRY Params[]=
+{
+    {"counter", &counter, PARTYPE_INT | PARTYPE_RO, 0, NULL, NULL, 0},
+    {"gain", &gain, PARTYPE_DOUBLE | PARTYPE_RW, 0, NULL, NULL, 0},
+    {"hostname", hostname, PARTYPE_STRING | PARTYPE_RO, sizeof(hostname), NULL, NULL, 0},
+    {"label", label, PARTYPE_STRING | PARTYPE_RW, sizeof(label), NULL, NULL, 0},
+    {"setpoint", &setpoint, PARTYPE_INT | PARTYPE_RW, 0, NULL, NULL, 0},
+    {"temp", &temp, PARTYPE_DOUBLE | PARTYPE_RO, 0, NULL, NULL, 0},
+    {NULL, NULL}
+};
+
+struct TRACE
+{
+    std::vector<uint8_t> bytes;
+    std::vector<unsigned long> ms;
+};
+
+class MbReplay
+{
+public:
+    static bool Load(const char *fileName);
+    static void Trim();
+    static void Run(bool lineMode);
+    static void Report();
+    static void Capture(const uint8_t *buffer, size_t size);
+    static void PrintContext(const char *key, const TRACE &trace, size_t pos);
+
+    static TRACE rx;
+    static std::vector<size_t> txBefore;
+    static TRACE txExpected;
+    static TRACE txReplayed;
+    static unsigned long start;
+    static unsigned long maxWaitMs;
+    static unsigned long maxWaitLine;
+    static unsigned long maxParseMs;
+    static unsigned long stalls;
+    static unsigned long durationMs;
+    static unsigned long txSkipped;
+};
+
+TRACE MbReplay::rx;
+std::vector<size_t> MbReplay::txBefore;
+TRACE MbReplay::txExpected;
+TRACE MbReplay::txReplayed;
+unsigned long MbReplay::start;
+unsigned long MbReplay::maxWaitMs;
+unsigned long MbReplay::maxWaitLine;
+unsigned long MbReplay::maxParseMs;
+unsigned long MbReplay::stalls;
+unsigned long MbReplay::durationMs;
+unsigned long MbReplay::txSkipped;
+
+static uint8_t arena[ARENA_SIZE];
+
+// Lines look like "+12 > 41 54 0d 0a", anything else (prompts, the
+// trace dump command itself) is skipped
+bool MbReplay::Load(const char *fileName)
+{
+    FILE *f = fopen(fileName, "r");
+    char line[256];
+    char *p, *end;
+    unsigned long ms = 0;
+    unsigned long lastTx = 0;
+    unsigned long lineNo = 0;
+    unsigned long delta, ch;
+    char dir, lastDir = 0;
+    int n;
+
+    if(f == NULL)
+        return false;
+    while(fgets(line, sizeof(line), f) != NULL)
+    {
+        lineNo++;
+        if(sscanf(line, "+%lu %c%n", &delta, &dir, &n) != 2 || (dir != '<' && dir != '>'))
+            continue;
+        ms += delta;
+        // Longest time the module took to answer
+        if(dir == '<' && lastDir == '>' && ms - lastTx > maxWaitMs)
+        {
+            maxWaitMs = ms - lastTx;
+            maxWaitLine = lineNo;
+        }
+        if(dir == '>')
+            lastTx = ms;
+        lastDir = dir;
+
+        TRACE &trace = dir == '<' ? rx : txExpected;
+        p = line + n;
+        while(true)
+        {
+            ch = strtoul(p, &end, 16);
+            if(end == p)
+                break;
+            trace.bytes.push_back(ch);
+            trace.ms.push_back(ms);
+            if(dir == '<')
+                txBefore.push_back(txExpected.bytes.size());
+            p = end;
+        }
+    }
+    fclose(f);
+    durationMs = ms;
+    return true;
+}
+
+// The trace starts within the trace start command. Its output and the
+// module's answers to it are dropped, the replay begins with the first
+// data received from the client and ends before the trace stop or
+// trace dump that stopped the recording.
+void MbReplay::Trim()
+{
+    static const char ipd[] = "+IPD,";
+    static const char cmd[] = "trace ";
+    size_t first = rx.bytes.size();
+    size_t last = rx.bytes.size();
+    size_t r, tx, i;
+    unsigned long t;
+
+    for(r=0;r+sizeof(ipd)-1<=rx.bytes.size();r++)
+    {
+        if(memcmp(rx.bytes.data() + r, ipd, sizeof(ipd)-1) == 0)
+        {
+            if(first == rx.bytes.size())
+                first = r;
+            last = r;
+        }
+    }
+    if(last < rx.bytes.size() && std::search(rx.bytes.begin() + last, rx.bytes.end(), cmd, cmd + sizeof(cmd)-1) != rx.bytes.end())
+    {
+        durationMs = rx.ms[last];
+        txExpected.bytes.resize(txBefore[last]);
+        txExpected.ms.resize(txBefore[last]);
+        rx.bytes.resize(last);
+        rx.ms.resize(last);
+    }
+    if(first > rx.bytes.size())
+        first = rx.bytes.size();
+
+    tx = first < rx.bytes.size() ? txBefore[first] : txExpected.bytes.size();
+    t = first < rx.bytes.size() ? rx.ms[first] : durationMs;
+    rx.bytes.erase(rx.bytes.begin(), rx.bytes.begin() + first);
+    rx.ms.erase(rx.ms.begin(), rx.ms.begin() + first);
+    txExpected.bytes.erase(txExpected.bytes.begin(), txExpected.bytes.begin() + tx);
+    txExpected.ms.erase(txExpected.ms.begin(), txExpected.ms.begin() + tx);
+    txSkipped = tx;
+    for(i=0;i<rx.ms.size();i++)
+        rx.ms[i] -= t;
+    for(i=0;i<txExpected.ms.size();i++)
+        txExpected.ms[i] -= t;
+    durationMs -= t;
+}
+
+void MbReplay::Capture(const uint8_t *buffer, size_t size)
+{
+    unsigned long now = millis() - start;
+
+    while(size--)
+    {
+        txReplayed.bytes.push_back(*buffer++);
+        txReplayed.ms.push_back(now);
+    }
+}
+
+// The module is in the state the trace started in: reset done, a client
+// connected and logged in
+void MbReplay::Run(bool lineMode)
+{
+    const MB_LIMITS limits = {128, 16, 0, 0, 0};
+    microBoxEsp shell;
+    unsigned long t, dur;
+    size_t i;
+
+    esp8266.pSerial = &Serial;
+    esp8266.initFinished = true;
+    esp8266.status = STATUS_ESP_CONNECTED;
+    shell.begin(Params, hostname, password, arena, sizeof(arena), &esp8266, &limits);
+    shell.loginState = STATE_LOGIN_LOGGEDIN;
+    shell.lineMode = lineMode;
+
+    start = millis();
+    for(i=0;i<rx.ms.size();i++)
+        rx.ms[i] += start;
+    Serial.FeedTimed(rx.bytes.data(), rx.ms.data(), rx.bytes.size());
+    Serial.SetWriteHook(Capture);
+
+    while(millis() - start < durationMs + TAIL_MS)
+    {
+        t = millis();
+        shell.cmdParser();
+        dur = millis() - t;
+        if(dur > maxParseMs)
+            maxParseMs = dur;
+        if(dur >= STALL_MS)
+            stalls++;
+        if(millis() - start > durationMs && txReplayed.bytes.size() >= txExpected.bytes.size() && !Serial.available())
+            break;
+    }
+    Serial.SetWriteHook(NULL);
+    Serial.Feed(NULL, 0);
+}
+
+void MbReplay::PrintContext(const char *key, const TRACE &trace, size_t pos)
+{
+    size_t i;
+    uint8_t ch;
+
+    printf("%s=\"", key);
+    for(i=pos;i<trace.bytes.size() && i<pos+CONTEXT;i++)
+    {
+        ch = trace.bytes[i];
+        if(ch == '\r')
+            printf("\\r");
+        else if(ch == '\n')
+            printf("\\n");
+        else if(ch < ' ' || ch > '~' || ch == '"' || ch == '\\')
+            printf("\\x%02x", ch);
+        else
+            putchar(ch);
+    }
+    printf("\"\n");
+}
+
+// first_diff is the offset of the first byte the library sent
+// differently, tx_lag_max_ms how much later than recorded it sent
+// a matching byte
+void MbReplay::Report()
+{
+    size_t i, n;
+    long diff = -1;
+    long lag, lagMax = 0;
+
+    n = txExpected.bytes.size() < txReplayed.bytes.size() ? txExpected.bytes.size() : txReplayed.bytes.size();
+    for(i=0;i<n;i++)
+    {
+        if(txExpected.bytes[i] != txReplayed.bytes[i])
+            break;
+        lag = (long)txReplayed.ms[i] - (long)txExpected.ms[i];
+        if(lag > lagMax)
+            lagMax = lag;
+    }
+    if(i < n || txReplayed.bytes.size() != txExpected.bytes.size())
+        diff = i;
+
+    printf("rx_bytes=%zu tx_expected=%zu tx_skipped=%lu tx_replayed=%zu first_diff=%ld tx_lag_max_ms=%ld "
+           "rec_max_wait_ms=%lu rec_max_wait_line=%lu max_parse_ms=%lu stalls=%lu\n",
+           rx.bytes.size(), txExpected.bytes.size(), txSkipped, txReplayed.bytes.size(), diff, lagMax,
+           maxWaitMs, maxWaitLine, maxParseMs, stalls);
+    if(diff >= 0)
+    {
+        PrintContext("expected", txExpected, diff);
+        PrintContext("replayed", txReplayed, diff);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool lineMode = true;
+
+    if(argc < 2)
+    {
+        fprintf(stderr, "usage: mbReplay trace.txt [-c]\n");
+        return 2;
+    }
+    if(argc > 2 && strcmp(argv[2], "-c") == 0)
+        lineMode = false;
+    if(!MbReplay::Load(argv[1]))
+    {
+        perror("mbReplay");
+        return 1;
+    }
+    MbReplay::Trim();
+    MbReplay::Run(lineMode);
+    MbReplay::Report();
+    return 0;
+}
@@ -0,0 +1,460 @@
+/*
+  mbXfer.cpp - Binary upload and download for the microBoxEsp bin command.
+  Logs in over telnet, starts "bin put|get" and runs the frame protocol:
+  SOH type seq len payload crc16, every data frame is acknowledged with
+  the next expected offset. An interrupted transfer is resumed by
+  passing the offset of the last acknowledged byte.
+
+  Usage: mbXfer host port password put|get target file [offset]
+  Released under GPLv3.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+
+#define TELNET_IAC  255
+#define TELNET_DONT 254
+#define TELNET_DO   253
+#define TELNET_WONT 252
+#define TELNET_WILL 251
+#define TELNET_SB   250
+#define TELNET_SE   240
+
+#define TELNET_OPT_ECHO     1
+#define TELNET_OPT_SGA      3
+#define TELNET_OPT_LINEMODE 34
+
+#define BIN_SOH    0x01
+#define BIN_DATA   'D'
+#define BIN_END    'E'
+#define BIN_ACK    'A'
+#define BIN_NAK    'N'
+#define BIN_CANCEL 'C'
+
+#define RETRY_MS   1000
+#define RETRIES    5
+#define LOGIN_MS   5000
+
+typedef struct
+{
+    uint8_t type;
+    uint8_t seq;
+    uint8_t len;
+    uint8_t data[255];
+}FRAME;
+
+static int fd;
+static uint8_t iacState = 0;
+static uint8_t iacCmd;
+static std::string rx;
+
+static uint64_t NowMs()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static uint16_t Crc16(uint16_t crc, uint8_t data)
+{
+    uint8_t i;
+
+    crc ^= (uint16_t)data << 8;
+    for(i=0;i<8;i++)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+}
+
+static void Send(const void *buf, size_t len)
+{
+    if(send(fd, buf, len, MSG_NOSIGNAL) != (ssize_t)len)
+    {
+        fprintf(stderr, "mbXfer: connection lost\n");
+        exit(1);
+    }
+}
+
+// Accepts linemode so the server does not echo
+static void TelnetReply(uint8_t cmd, uint8_t opt)
+{
+    uint8_t reply[3] = {TELNET_IAC, 0, opt};
+
+    if(cmd == TELNET_DO)
+        reply[1] = (opt == TELNET_OPT_LINEMODE) ? TELNET_WILL : TELNET_WONT;
+    else if(cmd == TELNET_WILL)
+        reply[1] = (opt == TELNET_OPT_ECHO || opt == TELNET_OPT_SGA) ? TELNET_DO : TELNET_DONT;
+    else
+        return;
+    Send(reply, sizeof(reply));
+}
+
+// Appends received data to rx, telnet commands are answered and
+// removed, IAC IAC is one 0xff data byte. False on timeout.
+static bool Receive(int ms)
+{
+    struct pollfd pfd = {fd, POLLIN, 0};
+    uint8_t buf[1024];
+    ssize_t len;
+    ssize_t i;
+
+    if(poll(&pfd, 1, ms) <= 0)
+        return false;
+    len = recv(fd, buf, sizeof(buf), 0);
+    if(len <= 0)
+    {
+        fprintf(stderr, "mbXfer: connection closed\n");
+        exit(1);
+    }
+    for(i=0;i<len;i++)
+    {
+        uint8_t ch = buf[i];
+
+        switch(iacState)
+        {
+        case 0:
+            if(ch == TELNET_IAC)
+                iacState = 1;
+            else
+                rx += (char)ch;
+            break;
+        case 1:
+            if(ch == TELNET_SB)
+                iacState = 3;
+            else if(ch >= TELNET_WILL && ch <= TELNET_DONT)
+            {
+                iacCmd = ch;
+                iacState = 2;
+            }
+            else
+            {
+                if(ch == TELNET_IAC)
+                    rx += (char)ch;
+                iacState = 0;
+            }
+            break;
+        case 2:
+            TelnetReply(iacCmd, ch);
+            iacState = 0;
+            break;
+        case 3:
+            if(ch == TELNET_IAC)
+                iacState = 4;
+            break;
+        case 4:
+            iacState = (ch == TELNET_SE) ? 0 : 3;
+            break;
+        }
+    }
+    return true;
+}
+
+static bool WaitFor(const char *text, int ms)
+{
+    uint64_t end = NowMs() + ms;
+    size_t pos;
+
+    while((pos = rx.find(text)) == std::string::npos)
+    {
+        if(NowMs() >= end || !Receive(end - NowMs()))
+            return false;
+    }
+    rx.erase(0, pos + strlen(text));
+    return true;
+}
+
+static void SendLine(const std::string &line)
+{
+    std::string out = line + "\r\n";
+
+    Send(out.data(), out.size());
+}
+
+// 0xff is doubled, the server would take it for a telnet command
+static void SendFrame(uint8_t type, uint8_t seq, const uint8_t *data, uint8_t len)
+{
+    std::string out;
+    uint16_t crc = 0xffff;
+    uint8_t hdr[3] = {type, seq, len};
+    uint8_t ch;
+    uint16_t i;
+
+    out += (char)BIN_SOH;
+    for(i=0;i<3+len+2;i++)
+    {
+        if(i < 3)
+            ch = hdr[i];
+        else if(i < 3+len)
+            ch = data[i-3];
+        else
+            ch = (i == 3+len) ? crc >> 8 : crc & 0xff;
+        if(i < 3+len)
+            crc = Crc16(crc, ch);
+        out += (char)ch;
+        if(ch == TELNET_IAC)
+            out += (char)ch;
+    }
+    Send(out.data(), out.size());
+}
+
+static void SendOffset(uint8_t type, uint8_t seq, uint16_t offset)
+{
+    uint8_t data[2] = {(uint8_t)(offset >> 8), (uint8_t)(offset & 0xff)};
+
+    SendFrame(type, seq, data, 2);
+}
+
+// Takes the next frame out of rx. Bytes before SOH and frames with
+// a bad CRC are dropped, the latter return false with *pBad set.
+static bool ReadFrame(FRAME *pFrame, int ms, bool *pBad)
+{
+    uint64_t end = NowMs() + ms;
+    uint16_t crc;
+    uint16_t i;
+    size_t len;
+
+    *pBad = false;
+    while(true)
+    {
+        while(!rx.empty() && rx[0] != BIN_SOH)
+            rx.erase(0, 1);
+        if(rx.size() >= 4)
+        {
+            len = (uint8_t)rx[3];
+            if(rx.size() >= 6 + len)
+                break;
+        }
+        if(NowMs() >= end || !Receive(end - NowMs()))
+            return false;
+    }
+    crc = 0xffff;
+    for(i=1;i<4+len;i++)
+        crc = Crc16(crc, (uint8_t)rx[i]);
+    if(crc != ((uint8_t)rx[4+len] << 8 | (uint8_t)rx[5+len]))
+    {
+        rx.erase(0, 1);
+        *pBad = true;
+        return false;
+    }
+    pFrame->type = rx[1];
+    pFrame->seq = rx[2];
+    pFrame->len = len;
+    memcpy(pFrame->data, rx.data() + 4, len);
+    rx.erase(0, 6 + len);
+    return true;
+}
+
+static uint16_t FrameOffset(const FRAME *pFrame)
+{
+    return pFrame->len == 2 ? pFrame->data[0] << 8 | pFrame->data[1] : 0xffff;
+}
+
+static int Connect(const char *host, const char *port)
+{
+    struct addrinfo hints;
+    struct addrinfo *res;
+    int sock;
+    int on = 1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+    if(getaddrinfo(host, port, &hints, &res) != 0)
+        return -1;
+
+    sock = socket(res->ai_family, res->ai_socktype, 0);
+    if(sock >= 0 && connect(sock, res->ai_addr, res->ai_addrlen) != 0)
+    {
+        close(sock);
+        sock = -1;
+    }
+    freeaddrinfo(res);
+    if(sock >= 0)
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+    return sock;
+}
+
+static bool Put(FILE *f, uint16_t size, uint16_t offset, uint8_t chunk)
+{
+    uint8_t buf[255];
+    uint8_t seq = 0;
+    uint8_t retries = 0;
+    size_t len;
+    FRAME frame;
+    bool bad;
+
+    while(true)
+    {
+        len = 0;
+        if(offset < size)
+        {
+            fseek(f, offset, SEEK_SET);
+            len = fread(buf, 1, (size - offset) < chunk ? (size - offset) : chunk, f);
+        }
+        if(len)
+            SendFrame(BIN_DATA, seq, buf, len);
+        else
+            SendOffset(BIN_END, seq, offset);
+
+        if(!ReadFrame(&frame, RETRY_MS, &bad))
+        {
+            if(bad || ++retries <= RETRIES)
+                continue;
+            fprintf(stderr, "mbXfer: timeout at offset %u\n", offset);
+            return false;
+        }
+        retries = 0;
+        if(frame.type == BIN_CANCEL)
+            return false;
+        if(frame.type == BIN_ACK && frame.seq == seq)
+        {
+            if(len == 0)
+                return true;
+            offset = FrameOffset(&frame);
+            seq++;
+        }
+        else if(frame.type == BIN_NAK)
+        {
+            offset = FrameOffset(&frame);
+            seq = frame.seq;
+        }
+    }
+}
+
+static bool Get(FILE *f, uint16_t size, uint16_t offset)
+{
+    uint8_t seq = 0;
+    uint8_t retries = 0;
+    FRAME frame;
+    bool bad;
+
+    while(true)
+    {
+        if(!ReadFrame(&frame, RETRY_MS * (RETRIES + 1), &bad))
+        {
+            if(bad)
+            {
+                SendOffset(BIN_NAK, seq, offset);
+                continue;
+            }
+            if(++retries > RETRIES)
+            {
+                fprintf(stderr, "mbXfer: timeout at offset %u\n", offset);
+                return false;
+            }
+            continue;
+        }
+        retries = 0;
+        if(frame.type == BIN_CANCEL)
+            return false;
+        if(frame.seq == (uint8_t)(seq - 1))
+        {
+            SendOffset(BIN_ACK, frame.seq, offset);  // Our ACK got lost
+            continue;
+        }
+        if(frame.seq != seq)
+            continue;
+        if(frame.type == BIN_END)
+        {
+            SendOffset(BIN_ACK, seq, offset);
+            return offset == size;
+        }
+        if(frame.type != BIN_DATA || offset + frame.len > size)
+            continue;
+        fseek(f, offset, SEEK_SET);
+        fwrite(frame.data, 1, frame.len, f);
+        offset += frame.len;
+        SendOffset(BIN_ACK, seq, offset);
+        seq++;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    FILE *f;
+    bool put;
+    bool ok;
+    unsigned size;
+    unsigned offset = 0;
+    unsigned chunk;
+    uint64_t start;
+    std::string cmd;
+    size_t pos;
+
+    if(argc < 7 || (strcmp(argv[4], "put") != 0 && strcmp(argv[4], "get") != 0))
+    {
+        fprintf(stderr, "Usage: %s host port password put|get target file [offset]\n", argv[0]);
+        return 1;
+    }
+    put = (argv[4][0] == 'p');
+    if(argc > 7)
+        offset = atoi(argv[7]);
+
+    f = fopen(argv[6], put ? "rb" : (offset ? "r+b" : "wb"));
+    if(f == NULL)
+    {
+        perror("mbXfer");
+        return 1;
+    }
+    fd = Connect(argv[1], argv[2]);
+    if(fd < 0)
+    {
+        fprintf(stderr, "mbXfer: connect failed\n");
+        return 1;
+    }
+
+    if(!WaitFor("login: ", LOGIN_MS))
+    {
+        fprintf(stderr, "mbXfer: no login prompt\n");
+        return 1;
+    }
+    SendLine("root");
+    WaitFor("Password:", LOGIN_MS);
+    SendLine(argv[3]);
+    if(!WaitFor(">", LOGIN_MS))
+    {
+        fprintf(stderr, "mbXfer: login failed\n");
+        return 1;
+    }
+
+    cmd = std::string("bin ") + argv[4] + " " + argv[5] + " " + std::to_string(offset);
+    SendLine(cmd);
+    // The reply line "bin: size offset chunk" is followed by the frames
+    if(!WaitFor("bin: ", LOGIN_MS))
+    {
+        fprintf(stderr, "mbXfer: no reply to %s\n", cmd.c_str());
+        return 1;
+    }
+    while((pos = rx.find('\n')) == std::string::npos)
+    {
+        if(!Receive(LOGIN_MS))
+            break;
+    }
+    if(sscanf(rx.c_str(), "%u %u %u", &size, &offset, &chunk) != 3)
+    {
+        fprintf(stderr, "mbXfer: %s\n", rx.substr(0, rx.find('\r')).c_str());
+        return 1;
+    }
+    rx.erase(0, pos + 1);
+
+    start = NowMs();
+    ok = put ? Put(f, size, offset, chunk) : Get(f, size, offset);
+    if(!ok)
+        SendOffset(BIN_CANCEL, 0, 0);
+    fclose(f);
+
+    printf("%s %s size=%u ms=%u result=%s\n", argv[4], argv[5], size,
+           (unsigned)(NowMs() - start), ok ? "ok" : "failed");
+    close(fd);
+    return ok ? 0 : 2;
+}
@@ -0,0 +1,186 @@
+/*
+  mbTmpFs.cpp - RAM files in /tmp for microBoxEsp.
+  Released under GPLv3.
+*/
+
+#include <mbTmpFs.h>
+
+#if MB_FEATURE_TMPFS
+
+MbTmpFs::MbTmpFs()
+{
+    begin(NULL, 0);
+}
+
+// The memory stays with the caller, all files are lost
+void MbTmpFs::begin(uint8_t *pBuf, uint16_t size)
+{
+    buf = pBuf;
+    bufSize = pBuf != NULL ? size : 0;
+    used = 0;
+    open = false;
+}
+
+// Replaces a file of the same name by an empty one at the end of the
+// buffer, write() appends to it until Finish()
+bool MbTmpFs::Create(const char *pName)
+{
+    uint8_t len = strlen(pName);
+    uint16_t size = 0;
+    int32_t pos;
+    uint16_t freed = 0;
+
+    if(open || len == 0 || len > TMP_NAME_LEN || strchr(pName, '/') != NULL)
+        return false;
+    // The old file stays if the new one does not fit
+    pos = FindPos(pName);
+    if(pos >= 0)
+        freed = EntrySize(pos);
+    if(used - freed + sizeof(size) + len + 1 > bufSize)
+        return false;
+    Remove(pName);
+
+    openPos = used;
+    memcpy(buf + used, &size, sizeof(size));
+    memcpy(buf + used + sizeof(size), pName, len + 1);
+    used += sizeof(size) + len + 1;
+    open = true;
+    truncated = false;
+    return true;
+}
+
+// Closes the file written to, false if output was cut off
+bool MbTmpFs::Finish()
+{
+    open = false;
+    return !truncated;
+}
+
+// Later files move down, the file being written can not be removed
+bool MbTmpFs::Remove(const char *pName)
+{
+    int32_t pos = FindPos(pName);
+    uint16_t len;
+
+    if(pos < 0 || (open && pos == openPos))
+        return false;
+    len = EntrySize(pos);
+    memmove(buf + pos, buf + pos + len, used - pos - len);
+    used -= len;
+    if(open && openPos > pos)
+        openPos -= len;
+    return true;
+}
+
+bool MbTmpFs::Open(const char *pName, const uint8_t **pData, uint16_t *pSize)
+{
+    int32_t pos = FindPos(pName);
+
+    if(pos < 0)
+        return false;
+    *pSize = FileSize(pos);
+    *pData = buf + pos + EntrySize(pos) - *pSize;
+    return true;
+}
+
+bool MbTmpFs::GetFile(uint8_t num, const char **pName, const uint8_t **pData, uint16_t *pSize)
+{
+    uint16_t pos = 0;
+
+    while(pos < used)
+    {
+        if(num-- == 0)
+        {
+            *pName = (const char*)buf + pos + sizeof(uint16_t);
+            *pSize = FileSize(pos);
+            *pData = buf + pos + EntrySize(pos) - *pSize;
+            return true;
+        }
+        pos += EntrySize(pos);
+    }
+    return false;
+}
+
+uint16_t MbTmpFs::Used()
+{
+    return used;
+}
+
+uint16_t MbTmpFs::Capacity()
+{
+    return bufSize;
+}
+
+int32_t MbTmpFs::FindPos(const char *pName)
+{
+    uint16_t pos = 0;
+
+    while(pos < used)
+    {
+        if(strcmp((const char*)buf + pos + sizeof(uint16_t), pName) == 0)
+            return pos;
+        pos += EntrySize(pos);
+    }
+    return -1;
+}
+
+uint16_t MbTmpFs::FileSize(uint16_t pos)
+{
+    uint16_t size;
+
+    memcpy(&size, buf + pos, sizeof(size));
+    return size;
+}
+
+uint16_t MbTmpFs::EntrySize(uint16_t pos)
+{
+    return sizeof(uint16_t) + strlen((const char*)buf + pos + sizeof(uint16_t)) + 1 + FileSize(pos);
+}
+
+uint8_t MbTmpFs::GetStatus()
+{
+    return STATUS_ESP_CONNECTED;
+}
+
+void MbTmpFs::Close()
+{
+}
+
+uint8_t MbTmpFs::Receive()
+{
+    return 0;
+}
+
+char MbTmpFs::read()
+{
+    return 0;
+}
+
+bool MbTmpFs::available()
+{
+    return false;
+}
+
+void MbTmpFs::clearBuffer(uint8_t avail)
+{
+}
+
+// The open file is the last one, it grows until the buffer is full
+void MbTmpFs::write(const uint8_t *buffer, size_t size)
+{
+    uint16_t fileSize;
+
+    if(!open)
+        return;
+    if(size > (size_t)(bufSize - used))
+    {
+        size = bufSize - used;
+        truncated = true;
+    }
+    memcpy(buf + used, buffer, size);
+    used += size;
+    fileSize = FileSize(openPos) + size;
+    memcpy(buf + openPos, &fileSize, sizeof(fileSize));
+}
+
+#endif
@@ -0,0 +1,57 @@
+/*
+  mbTmpFs.h - RAM files in /tmp for microBoxEsp.
+  Released under GPLv3.
+*/
+
+#ifndef _MBTMPFS_H_
+#define _MBTMPFS_H_
+
+#include <mbTransport.h>
+#include <microBoxConfig.h>
+
+#if MB_FEATURE_TMPFS
+
+#define TMP_NAME_LEN 12
+
+// Files stored back to back in a caller-supplied buffer, each as
+// size (2 bytes), name with terminating 0 and data. As a transport it
+// appends everything written to the file opened by Create(), that is
+// how output is redirected into a file.
+class MbTmpFs : public MbTransport
+{
+public:
+    MbTmpFs();
+    void begin(uint8_t *pBuf, uint16_t size);
+    bool Create(const char *pName);
+    bool Finish();
+    bool Remove(const char *pName);
+    bool Open(const char *pName, const uint8_t **pData, uint16_t *pSize);
+    bool GetFile(uint8_t num, const char **pName, const uint8_t **pData, uint16_t *pSize);
+    uint16_t Used();
+    uint16_t Capacity();
+
+    uint8_t GetStatus();
+    void Close();
+    uint8_t Receive();
+    char read();
+    bool available();
+    void clearBuffer(uint8_t avail = 0);
+    void write(const uint8_t *buffer, size_t size);
+
+private:
+    int32_t FindPos(const char *pName);
+    uint16_t FileSize(uint16_t pos);
+    uint16_t EntrySize(uint16_t pos);
+
+private:
+    uint8_t *buf;
+    uint16_t bufSize;
+    uint16_t used;
+    uint16_t openPos;
+    bool open;
+    bool truncated;
+};
+
+#endif
+
+#endif
@@ -0,0 +1,84 @@
+/*
+  mbTransport.cpp - Transport interface for microBoxEsp.
+  Released under GPLv3.
+*/
+
+#include <mbTransport.h>
+
+bool MbTransport::IsTelnet()
+{
+    return false;
+}
+
+void MbTransport::StartCoalesce()
+{
+}
+
+void MbTransport::EndCoalesce()
+{
+}
+
+// Queues from the shell's arena, backends without queues ignore them
+void MbTransport::SetBuffers(uint8_t *pTx, uint16_t txLen, uint8_t *pRx, uint16_t rxLen)
+{
+}
+
+void MbTransport::print(const __FlashStringHelper *buffer)
+{
+    const prog_char *p = (const prog_char*)buffer;
+    uint8_t tmp[16];
+    uint8_t len = 0;
+
+    while((tmp[len] = pgm_read_byte_near(p++)) != 0)
+    {
+        if(++len == sizeof(tmp))
+        {
+            write(tmp, len);
+            len = 0;
+        }
+    }
+    if(len)
+        write(tmp, len);
+}
+
+void MbTransport::print(const char *buffer)
+{
+    write((const uint8_t *)buffer, strlen(buffer));
+}
+
+void MbTransport::print(int val)
+{
+    char tmp[12];       // 32-bit int with sign
+
+    itoa(val, tmp, 10);
+    print(tmp);
+}
+
+void MbTransport::print(double val, int digits)
+{
+    char tmp[22];
+
+    // Same limit as Print::printFloat()
+    if(val > 4294967040.0 || val < -4294967040.0)
+        strcpy_P(tmp, PSTR("ovf"));
+    else
+        dtostrf(val, 1, digits > 8 ? 8 : digits, tmp);
+    print(tmp);
+}
+
+void MbTransport::println(const __FlashStringHelper *buffer)
+{
+    print(buffer);
+    println();
+}
+
+void MbTransport::println(const char *buffer)
+{
+    print(buffer);
+    println();
+}
+
+void MbTransport::println()
+{
+    write((const uint8_t *)"\r\n", 2);
+}
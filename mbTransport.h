@@ -0,0 +1,44 @@
+/*
+  mbTransport.h - Transport interface for microBoxEsp.
+  Released under GPLv3.
+*/
+
+#ifndef _MBTRANSPORT_H_
+#define _MBTRANSPORT_H_
+
+#define __PROG_TYPES_COMPAT__
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+
+#define STATUS_ESP_DISCONNECTED 0
+#define STATUS_ESP_CONNECTED 1
+
+// Byte stream the shell talks over. Backends must implement the
+// connection handling, read() and write(), the print functions are
+// formatted here and may be overridden if the backend can do better.
+class MbTransport
+{
+public:
+    virtual ~MbTransport() {}
+    virtual uint8_t GetStatus() = 0;
+    virtual void Close() = 0;
+    virtual uint8_t Receive() = 0;
+    virtual char read() = 0;
+    virtual bool available() = 0;
+    virtual void clearBuffer(uint8_t avail = 0) = 0;
+    virtual void write(const uint8_t *buffer, size_t size) = 0;
+    virtual bool IsTelnet();
+    virtual void StartCoalesce();
+    virtual void EndCoalesce();
+    virtual void SetBuffers(uint8_t *pTx, uint16_t txLen, uint8_t *pRx, uint16_t rxLen);
+
+    virtual void print(const __FlashStringHelper *buffer);
+    virtual void print(const char *buffer);
+    virtual void print(int val);
+    virtual void print(double val, int digits);
+    virtual void println(const __FlashStringHelper *buffer);
+    virtual void println(const char *buffer);
+    virtual void println();
+};
+
+#endif
@@ -0,0 +1,94 @@
+/*
+  microBoxConfig.h - Compile time configuration of microBoxEsp.
+  Released under GPLv3.
+*/
+
+#ifndef _MICROBOXCONFIG_H_
+#define _MICROBOXCONFIG_H_
+
+// Features set to 0, here or with a compiler flag like
+// -DMB_FEATURE_WATCH=0, leave no code or data in the build.
+// With MB_FEATURE_PROFILER /proc/conf shows the configuration and the
+// RAM it uses.
+// The library and the sketch have to be built with the same
+// switches, the class microBoxEsp differs between configurations.
+// CMD_ENTRY and PARAM_ENTRY do not.
+
+#ifndef MB_FEATURE_WATCH
+#define MB_FEATURE_WATCH      1     // watch, watchcsv
+#endif
+#ifndef MB_FEATURE_EEPROM
+#define MB_FEATURE_EEPROM     1     // loadpar, savepar
+#endif
+#ifndef MB_FEATURE_LOGIN
+#define MB_FEATURE_LOGIN      1     // Without it sessions start logged in
+#endif
+#ifndef MB_FEATURE_HISTORY
+#define MB_FEATURE_HISTORY    1     // Cursor up/down
+#endif
+#ifndef MB_FEATURE_COMPLETION
+#define MB_FEATURE_COMPLETION 1     // Tab
+#endif
+#ifndef MB_FEATURE_SCRIPTS
+#define MB_FEATURE_SCRIPTS    1     // sh, AddScript(), /etc
+#endif
+#ifndef MB_FEATURE_DUMPLOAD
+#define MB_FEATURE_DUMPLOAD   1     // dump, load
+#endif
+#ifndef MB_FEATURE_PROFILER
+#define MB_FEATURE_PROFILER   0     // /proc, echo 1 > /proc/reset, 10 bytes RAM per command
+#endif
+#ifndef MB_FEATURE_RECORDER
+#define MB_FEATURE_RECORDER   1     // rec, SetRecordBuffer()
+#endif
+#ifndef MB_FEATURE_BINARY
+#define MB_FEATURE_BINARY     1     // bin, binary transfers
+#endif
+#ifndef MB_FEATURE_TRANSACTION
+#define MB_FEATURE_TRANSACTION 1    // begin, commit, abort, SetTransactionBuffer()
+#endif
+#ifndef MB_FEATURE_GETCACHE
+#define MB_FEATURE_GETCACHE   1     // SetMaxAge(), InvalidateCache()
+#endif
+#ifndef MB_FEATURE_SEQLOCK
+#define MB_FEATURE_SEQLOCK    1     // PARTYPE_SEQLOCK, SetSeqLock()
+#endif
+#ifndef MB_FEATURE_STREAM
+#define MB_FEATURE_STREAM     1     // More() spreads output over cmdParser() passes
+#endif
+#ifndef MB_FEATURE_TRACE
+#define MB_FEATURE_TRACE      1     // trace, Esp8266::SetTraceBuffer()
+#endif
+#ifndef MB_FEATURE_TMPFS
+#define MB_FEATURE_TMPFS      1     // /tmp files, cmd > /tmp/file, rm, SetTmpBuffer()
+#endif
+
+#ifndef MAX_CMD_NUM
+#define MAX_CMD_NUM 20      // Commands added with AddCommand(), plus one
+#endif
+#ifndef MAX_SCRIPT_NUM
+#define MAX_SCRIPT_NUM 5
+#endif
+#ifndef MAX_SCRIPT_DEPTH
+#define MAX_SCRIPT_DEPTH 2
+#endif
+#ifndef MAX_PENDING_SET
+#define MAX_PENDING_SET 8
+#endif
+#ifndef MAX_CMD_BUF_SIZE
+#define MAX_CMD_BUF_SIZE 40
+#endif
+#ifndef MAX_CMD_ARGS
+#define MAX_CMD_ARGS 10
+#endif
+#ifndef MAX_REC_PARAMS
+#define MAX_REC_PARAMS 4
+#endif
+#ifndef MAX_GET_CACHE
+#define MAX_GET_CACHE 8     // Parameters with maxAge cached at a time
+#endif
+#ifndef MAX_SEQ_RETRIES
+#define MAX_SEQ_RETRIES 8
+#endif
+
+#endif
@@ -9,89 +9,565 @@
 #include <microBoxEsp.h>
 #include <esp8266.h>
 #include <avr/pgmspace.h>
+#if MB_FEATURE_EEPROM
 #include <avr/eeprom.h>
+#endif
 
 microBoxEsp microbox;
+microBoxEsp *microBoxEsp::pActive = &microbox;
+#if MB_FEATURE_GETCACHE
+uint8_t microBoxEsp::getGen = 1;     // Entries start at 0, never fresh
+GET_CACHE microBoxEsp::getCache[MAX_GET_CACHE];
+#endif
 const prog_char fileDate[] PROGMEM = __DATE__;
 
-CMD_ENTRY microBoxEsp::Cmds[] =
+// Builtins[], Cmds[] and dirList[] are sorted, completion searches them
+// binary. The node numbers NODE_BIN... depend on the order of dirList[].
+const BUILTIN_ENTRY microBoxEsp::Builtins[] PROGMEM =
 {
+#if MB_FEATURE_TRANSACTION
+    {"abort", microBoxEsp::AbortCB},
+    {"begin", microBoxEsp::BeginCB},
+#endif
+#if MB_FEATURE_BINARY
+    {"bin", microBoxEsp::BinaryCB},
+#endif
     {"cat", microBoxEsp::CatCB},
     {"cd", microBoxEsp::ChangeDirCB},
+#if MB_FEATURE_TRANSACTION
+    {"commit", microBoxEsp::CommitCB},
+#endif
+#if MB_FEATURE_DUMPLOAD
+    {"dump", microBoxEsp::DumpCB},
+#endif
     {"echo", microBoxEsp::EchoCB},
     {"exit", microBoxEsp::ExitCB},
-    {"loadpar", microBoxEsp::LoadParCB},
     {"ll", microBoxEsp::ListLongCB},
+#if MB_FEATURE_DUMPLOAD
+    {"load", microBoxEsp::LoadCB},
+#endif
+#if MB_FEATURE_EEPROM
+    {"loadpar", microBoxEsp::LoadParCB},
+#endif
     {"ls", microBoxEsp::ListDirCB},
+#if MB_FEATURE_RECORDER
+    {"rec", microBoxEsp::RecordCB},
+#endif
+#if MB_FEATURE_TMPFS
+    {"rm", microBoxEsp::RemoveCB},
+#endif
+#if MB_FEATURE_EEPROM
     {"savepar", microBoxEsp::SaveParCB},
+#endif
+#if MB_FEATURE_SCRIPTS
+    {"sh", microBoxEsp::ShellCB},
+#endif
+#if MB_FEATURE_TRACE
+    {"trace", microBoxEsp::TraceCB},
+#endif
+#if MB_FEATURE_WATCH
     {"watch", microBoxEsp::watchCB},
     {"watchcsv", microBoxEsp::watchcsvCB},
-    {NULL, NULL}
+#endif
 };
 
+#define BUILTIN_NUM (sizeof(microBoxEsp::Builtins)/sizeof(microBoxEsp::Builtins[0]))
+
+CMD_ENTRY microBoxEsp::Cmds[MAX_CMD_NUM];
+#if MB_FEATURE_PROFILER
+CMD_STAT microBoxEsp::cmdStats[BUILTIN_NUM + MAX_CMD_NUM - 1];
+#endif
+
+#if MB_FEATURE_SCRIPTS
+SCRIPT_ENTRY microBoxEsp::Scripts[MAX_SCRIPT_NUM];
+#endif
+
+#if MB_FEATURE_TMPFS
+MbTmpFs microBoxEsp::TmpFs;
+#endif
+
+// Node tree until begin() has set up the arena
+static MB_NODE emptyRoot = {"", NODE_ROOT, 1, 0, 0, NODE_DIR};
+
 const char microBoxEsp::dirList[][5] PROGMEM =
 {
-    "bin", "dev", "etc", "proc", "sbin", "var", "lib", "sys", "tmp", "usr", ""
+    "bin", "dev", "etc", "lib", "proc", "sbin", "sys", "tmp", "usr", "var", ""
+};
+
+#if MB_FEATURE_PROFILER
+const char microBoxEsp::procList[][6] PROGMEM =
+{
+    "cmds", "conf", "loop", "mem", "reset", ""
 };
 
+#ifdef __AVR__
+extern char __heap_start;
+extern char *__brkval;
+#endif
+#endif
+
 microBoxEsp::microBoxEsp()
 {
     bufPos = 0;
-    watchMode = false;
-    csvMode = false;
+    cmdError = false;
     loginState = STATE_LOGIN_DISCONNECTED;
     blockRead = 0;
-    watchTimeout = 0;
     escSeq = 0;
+    telnetState = TELNET_STATE_DATA;
+    lineMode = false;
+    echoOff = false;
+    serAvail = 0;
+    Nodes = &emptyRoot;
+    nodeCnt = 1;
+    curNode = NODE_ROOT;
+    cmdBuf = NULL;
+    cmdBufSize = 0;
+    ParmPtr = NULL;
+    maxArgs = 0;
+    ownArena = NULL;
+#if MB_FEATURE_HISTORY
+    historyBuf = NULL;
     historyWrPos = 0;
     historyBufSize = 0;
-    serAvail = 0;
     historyCursorPos = -1;
+#endif
+#if MB_FEATURE_COMPLETION
+    tabPressed = false;
+#endif
+#if MB_FEATURE_SCRIPTS
+    scriptLines = NULL;
+    scriptDepth = 0;
+#endif
+#if MB_FEATURE_DUMPLOAD
+    loadMode = false;
+    lineCut = false;
+#endif
+#if MB_FEATURE_DUMPLOAD || MB_FEATURE_TRANSACTION
+    pendingCnt = 0;
+#endif
+#if MB_FEATURE_TRANSACTION
+    txnBuf = NULL;
+    txnSize = 0;
+    txnLen = 0;
+    txnActive = false;
+#endif
+    streamState = 0;
+    streamMore = false;
+#if MB_FEATURE_STREAM
+    streamCmd = -1;
+#endif
+#if MB_FEATURE_WATCH
+    watchMode = false;
+    csvMode = false;
+    watchTimeout = 0;
+    watchOnChange = false;
+    watchWindow = 0;
+#endif
+#if MB_FEATURE_GETCACHE
+    pAges = NULL;
+#endif
+#if MB_FEATURE_SEQLOCK
+    pSeqs = NULL;
+#endif
+#if MB_FEATURE_RECORDER
+    recBuf = NULL;
+    recSize = 0;
+    recParCnt = 0;
+    recCnt = 0;
+    recTotal = 0;
+    recSkipped = 0;
+    recActive = false;
+#endif
+#if MB_FEATURE_BINARY
+    binMode = BIN_OFF;
+    binRxState = BIN_RX_SOH;
+#endif
+#if MB_FEATURE_PROFILER
+    Reset();
+#endif
 }
 
 microBoxEsp::~microBoxEsp()
 {
+    free(ownArena);
 }
 
-void microBoxEsp::begin(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, char *histBuf, int historySize, HardwareSerial *serial)
+bool microBoxEsp::begin(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, char *histBuf, int historySize, HardwareSerial *serial)
 {
     esp8266.begin(serial);
-    pSerial = serial;
+    return begin(pParams, hostName, loginPassword, histBuf, historySize, &esp8266);
+}
+
+// Command line, parameter pointers and node tree with the default limits.
+// They are allocated once from the heap, false if that fails. The arena
+// begin() below never allocates.
+bool microBoxEsp::begin(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, char *histBuf, int historySize, MbTransport *transport)
+{
+    MB_LIMITS limits = {MAX_CMD_BUF_SIZE, MAX_CMD_ARGS, 0, 0, 0};
+    uint16_t size = ArenaSize(pParams, &limits);
+    bool ok = false;
+
+    Init(pParams, hostName, loginPassword, transport);
+    free(ownArena);
+    ownArena = (uint8_t*)malloc(size);
+    if(ownArena != NULL)
+        ok = SetupArena(ownArena, size, &limits);
+
+#if MB_FEATURE_HISTORY
     historyBuf = histBuf;
-    if(historyBuf != NULL && historySize != 0)
+    historyBufSize = 0;
+    if(historyBuf != NULL && historySize > 1)
     {
         historyBufSize = historySize;
         historyBuf[0] = 0;
         historyBuf[1] = 0;
     }
+#endif
+    return ok;
+}
+
+// All per-session buffers and the node tree come from pArena, split
+// according to pLimits. False if the arena is too small, see ArenaSize().
+bool microBoxEsp::begin(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, uint8_t *arena, uint16_t arenaSize, MbTransport *transport, const MB_LIMITS *pLimits)
+{
+    Init(pParams, hostName, loginPassword, transport);
+    return SetupArena(arena, arenaSize, pLimits);
+}
+
+// Bytes the arena needs for pParams and pLimits. With historyLen 0 the
+// history gets what the arena has on top of that.
+uint16_t microBoxEsp::ArenaSize(PARAM_ENTRY *pParams, const MB_LIMITS *pLimits)
+{
+    MB_LIMITS lim = {MAX_CMD_BUF_SIZE, MAX_CMD_ARGS, 0, 0, 0};
+    uint16_t paramNum;
+    uint32_t need;
+    uint32_t rest;
+
+    if(pLimits != NULL)
+        lim = *pLimits;
+    need = (uint32_t)CountNodes(pParams, &paramNum) * sizeof(MB_NODE);
+    rest = (uint32_t)lim.lineLen + lim.txLen + lim.rxLen + lim.historyLen;
+#if MB_FEATURE_SCRIPTS
+    rest += (uint32_t)MAX_SCRIPT_DEPTH * lim.lineLen;
+#endif
+    // The sort order of the parameters is kept behind the tree while it
+    // is built, in the space of the buffers that follow
+    if(rest < paramNum * sizeof(uint16_t))
+        rest = paramNum * sizeof(uint16_t);
+    need += (sizeof(char*) - 1) + lim.maxArgs * sizeof(char*) + rest;
+    return need > 0xffff ? 0xffff : need;
+}
+
+bool microBoxEsp::SetupArena(uint8_t *pArena, uint16_t size, const MB_LIMITS *pLimits)
+{
+    MB_LIMITS lim = {MAX_CMD_BUF_SIZE, MAX_CMD_ARGS, 0, 0, 0};
+    uint8_t pad;
+    uint16_t need;
+    uint16_t paramNum;
+    uint16_t treeSize;
+
+    if(pLimits != NULL)
+        lim = *pLimits;
+
+    need = ArenaSize(Params, &lim);
+    if(pArena == NULL || lim.lineLen < 2 || lim.maxArgs == 0 || need > size || need == 0xffff)
+        return false;
+
+    // ParmPtr and the tree need pointer alignment
+    pad = (uint8_t)(-(uintptr_t)pArena) & (sizeof(char*)-1);
+    pArena += pad;
+    size -= pad + lim.maxArgs * sizeof(char*);
+    ParmPtr = (char**)pArena;
+    maxArgs = lim.maxArgs;
+    ParmPtr[0] = NULL;
+    pArena += lim.maxArgs * sizeof(char*);
+
+    treeSize = CountNodes(Params, &paramNum) * sizeof(MB_NODE);
+    Nodes = (MB_NODE*)pArena;
+    BuildTree((uint16_t*)(pArena + treeSize));
+    pArena += treeSize;
+    size -= treeSize;
+
+    cmdBuf = (char*)pArena;
+    cmdBufSize = lim.lineLen;
+    cmdBuf[0] = 0;
+    pArena += lim.lineLen;
+    size -= lim.lineLen;
+#if MB_FEATURE_SCRIPTS
+    scriptLines = (char*)pArena;
+    pArena += MAX_SCRIPT_DEPTH * lim.lineLen;
+    size -= MAX_SCRIPT_DEPTH * lim.lineLen;
+#endif
+
+    pTransport->SetBuffers(lim.txLen ? pArena : NULL, lim.txLen, lim.rxLen ? pArena + lim.txLen : NULL, lim.rxLen);
+    pArena += lim.txLen + lim.rxLen;
+
+#if MB_FEATURE_HISTORY
+    if(lim.historyLen == 0)
+        lim.historyLen = size - (lim.txLen + lim.rxLen);
+    historyBufSize = 0;
+    historyBuf = NULL;
+    if(lim.historyLen > 1)
+    {
+        historyBuf = (char*)pArena;
+        historyBufSize = lim.historyLen;
+        historyBuf[0] = 0;
+        historyBuf[1] = 0;
+    }
+    historyWrPos = 0;
+    historyCursorPos = -1;
+#endif
+    bufPos = 0;
+
+    return true;
+}
 
+void microBoxEsp::Init(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, MbTransport *transport)
+{
+    pTransport = transport;
     Params = pParams;
+    // Until the arena is set up
+    Nodes = &emptyRoot;
+    nodeCnt = 1;
+    cmdBuf = NULL;
+    bufPos = 0;
     machName = hostName;
+#if MB_FEATURE_LOGIN
     password = loginPassword;
-    ParmPtr[0] = NULL;
-    currentDir[0] = '/';
-    currentDir[1] = 0;
+#endif
+    curNode = NODE_ROOT;
+#if MB_FEATURE_PROFILER
+    PaintStack();
+#endif
+}
+
+MbTransport *microBoxEsp::GetTransport()
+{
+    return pTransport;
+}
+
+// Path order with '/' below all other characters, so the entries
+// of a group sort directly behind its name
+static int8_t PathCmp(const char *pPath1, const char *pPath2)
+{
+    uint8_t c1, c2;
+
+    do
+    {
+        c1 = *pPath1++;
+        c2 = *pPath2++;
+        if(c1 == '/')
+            c1 = 1;
+        if(c2 == '/')
+            c2 = 1;
+    }while(c1 != 0 && c1 == c2);
+
+    if(c1 < c2)
+        return -1;
+    return c1 > c2;
+}
+
+// Upper bound of the nodes BuildTree() creates for pParams
+uint16_t microBoxEsp::CountNodes(PARAM_ENTRY *pParams, uint16_t *pParamNum)
+{
+    uint16_t paramNum = 0;
+    uint16_t maxNodes = 1;
+    uint8_t i = 0;
+    const char *p;
+
+    while(pgm_read_byte_near(&dirList[i++][0]) != 0)
+        maxNodes++;
+#if MB_FEATURE_PROFILER
+    i = 0;
+    while(pgm_read_byte_near(&procList[i++][0]) != 0)
+        maxNodes++;
+#endif
+    while(pParams[paramNum].paramName != NULL)
+    {
+        maxNodes++;
+        for(p=pParams[paramNum].paramName;*p!=0;p++)
+        {
+            if(*p == '/')
+                maxNodes++;
+        }
+        paramNum++;
+    }
+    *pParamNum = paramNum;
+    return maxNodes;
+}
+
+// Compiles dirList[] and the parameter names into the node tree at
+// Nodes, sized by CountNodes(). pOrder is scratch space for the sorted
+// parameter indices. A parameter "pid/kp" becomes the file kp in the
+// directory /dev/pid. The children of a directory are stored back to
+// back in sorted order, so lookups in a directory are binary searches.
+void microBoxEsp::BuildTree(uint16_t *pOrder)
+{
+    uint16_t *order = pOrder;
+    uint16_t paramNum = 0;
+    uint16_t i, j;
+    uint8_t dirNum = 0;
+#if MB_FEATURE_PROFILER
+    uint8_t procNum = 0;
+#endif
+
+    while(pgm_read_byte_near(&dirList[dirNum][0]) != 0)
+        dirNum++;
+#if MB_FEATURE_PROFILER
+    while(pgm_read_byte_near(&procList[procNum][0]) != 0)
+        procNum++;
+#endif
+    while(Params[paramNum].paramName != NULL)
+        paramNum++;
+
+    for(i=0;i<paramNum;i++)
+    {
+        j = i;
+        while(j > 0 && PathCmp(Params[order[j-1]].paramName, Params[i].paramName) > 0)
+        {
+            order[j] = order[j-1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    Nodes[NODE_ROOT].name = "";
+    Nodes[NODE_ROOT].nameLen = 0;
+    Nodes[NODE_ROOT].parent = NODE_ROOT;
+    Nodes[NODE_ROOT].flags = NODE_DIR;
+    Nodes[NODE_ROOT].idx = 1;
+    Nodes[NODE_ROOT].childCnt = dirNum;
+    for(i=1;i<=dirNum;i++)
+    {
+        Nodes[i].name = dirList[i-1];
+        Nodes[i].nameLen = strlen_P(dirList[i-1]);
+        Nodes[i].parent = NODE_ROOT;
+        Nodes[i].flags = NODE_DIR | NODE_FLASH;
+        Nodes[i].idx = 0;
+        Nodes[i].childCnt = 0;
+    }
+    nodeCnt = 1 + dirNum;
+
+    // Until a directory is expanded idx/childCnt hold its range in order[]
+    Nodes[NODE_DEV].childCnt = paramNum;
+    for(i=1;i<nodeCnt;i++)
+    {
+        if(Nodes[i].flags & NODE_DIR)
+            ExpandNode(i, order);
+    }
+
+#if MB_FEATURE_PROFILER
+    Nodes[NODE_PROC_DIR].idx = nodeCnt;
+    Nodes[NODE_PROC_DIR].childCnt = procNum;
+    for(i=0;i<procNum;i++)
+    {
+        Nodes[nodeCnt].name = procList[i];
+        Nodes[nodeCnt].nameLen = strlen_P(procList[i]);
+        Nodes[nodeCnt].parent = NODE_PROC_DIR;
+        Nodes[nodeCnt].flags = NODE_PROC | NODE_FLASH;
+        Nodes[nodeCnt].idx = i;
+        Nodes[nodeCnt].childCnt = 0;
+        nodeCnt++;
+    }
+#endif
+}
+
+void microBoxEsp::ExpandNode(uint16_t node, uint16_t *pOrder)
+{
+    uint16_t i = Nodes[node].idx;
+    uint16_t end = i + Nodes[node].childCnt;
+    uint16_t j;
+    uint8_t prefix = 0;
+    uint8_t len;
+    const char *pName;
+    MB_NODE *pChild;
+
+    if(!(Nodes[node].flags & NODE_FLASH))
+        prefix = Nodes[node].name - Params[pOrder[i]].paramName + Nodes[node].nameLen + 1;
+
+    Nodes[node].idx = nodeCnt;
+    Nodes[node].childCnt = 0;
+    while(i < end)
+    {
+        pName = Params[pOrder[i]].paramName + prefix;
+        len = 0;
+        while(pName[len] != 0 && pName[len] != '/')
+            len++;
+
+        pChild = &Nodes[nodeCnt++];
+        pChild->name = pName;
+        pChild->nameLen = len;
+        pChild->parent = node;
+        if(pName[len] == 0)
+        {
+            pChild->flags = NODE_PARAM;
+            pChild->idx = pOrder[i];
+            pChild->childCnt = 0;
+            i++;
+        }
+        else
+        {
+            j = i+1;
+            while(j < end && strncmp(Params[pOrder[j]].paramName + prefix, pName, len+1) == 0)
+                j++;
+            pChild->flags = NODE_DIR;
+            pChild->idx = i;
+            pChild->childCnt = j-i;
+            i = j;
+        }
+        Nodes[node].childCnt++;
+    }
 }
 
 bool microBoxEsp::AddCommand(const char *cmdName, void (*cmdFunc)(char **param, uint8_t parCnt))
 {
     uint8_t idx = 0;
+    uint8_t pos;
 
+    if(FindCmd(cmdName, strlen(cmdName)) != -1)
+        return false;
     while((Cmds[idx].cmdFunc != NULL) && (idx < (MAX_CMD_NUM-1)))
     {
         idx++;
     }
     if(idx < (MAX_CMD_NUM-1))
     {
-        Cmds[idx].cmdName = cmdName;
-        Cmds[idx].cmdFunc = cmdFunc;
+        // Insert sorted, the terminating entry moves up as well
+        pos = idx;
+        while(pos > 0 && strcmp(Cmds[pos-1].cmdName, cmdName) > 0)
+            pos--;
+        memmove(&Cmds[pos+1], &Cmds[pos], (idx-pos+1)*sizeof(CMD_ENTRY));
+        Cmds[pos].cmdName = cmdName;
+        Cmds[pos].cmdFunc = cmdFunc;
+#if MB_FEATURE_PROFILER
+        memmove(&cmdStats[BUILTIN_NUM+pos+1], &cmdStats[BUILTIN_NUM+pos], (idx-pos)*sizeof(CMD_STAT));
+        memset(&cmdStats[BUILTIN_NUM+pos], 0, sizeof(CMD_STAT));
+#endif
+        return true;
+    }
+    return false;
+}
+
+#if MB_FEATURE_SCRIPTS
+// Registers a script stored in flash. Commands are separated by '\n',
+// ';' or '&&' and the script is started with "sh <scriptName>".
+bool microBoxEsp::AddScript(const char *scriptName, const prog_char *script)
+{
+    uint8_t idx = 0;
+
+    while((idx < MAX_SCRIPT_NUM) && (Scripts[idx].scriptName != NULL))
+    {
         idx++;
-        Cmds[idx].cmdFunc = NULL;
-        Cmds[idx].cmdName = NULL;
+    }
+    if(idx < MAX_SCRIPT_NUM)
+    {
+        Scripts[idx].scriptName = scriptName;
+        Scripts[idx].script = script;
         return true;
     }
     return false;
 }
+#endif
 
 bool microBoxEsp::isTimeout(unsigned long *lastTime, unsigned long intervall)
 {
@@ -108,973 +584,3341 @@ bool microBoxEsp::isTimeout(unsigned long *lastTime, unsigned long intervall)
 
 void microBoxEsp::ShowPrompt()
 {
-    strcpy_P(cmdBuf, PSTR("root@"));
-    strcat(cmdBuf, machName);
-    strcat_P(cmdBuf, PSTR(":"));
-    strcat(cmdBuf, currentDir);
-    strcat_P(cmdBuf, PSTR(">"));
-
-    esp8266.print(cmdBuf);
-
-    cmdBuf[0] = 0;
+    pTransport->StartCoalesce();
+    pTransport->print(F("root@"));
+    pTransport->print(machName);
+    pTransport->print(F(":"));
+    PrintPath(curNode);
+    pTransport->print(F(">"));
+    pTransport->EndCoalesce();
 }
 
-uint8_t microBoxEsp::ParseCmdParams(char *pParam)
+// Splits pParam in place into ParmPtr[], nothing is copied.
+// Tokens are separated by spaces or tabs, "..." and '...' keep spaces
+// and a backslash escapes the next character (not within '...').
+// Returns the number of tokens or PARSE_ERR_ARGS/PARSE_ERR_QUOTE.
+int16_t microBoxEsp::ParseCmdParams(char *pParam)
 {
-    uint8_t idx = 0;
+    uint8_t cnt = 0;
+    char *pWr;
+    char quote;
 
-    ParmPtr[idx] = pParam;
-    if(pParam != NULL)
+    ParmPtr[0] = NULL;
+    if(pParam == NULL)
+        return 0;
+
+    while(true)
     {
-        idx++;
-        while((pParam = strchr(pParam, ' ')) != NULL)
-        {
-            pParam[0] = 0;
+        while(*pParam == ' ' || *pParam == '\t')
             pParam++;
-            ParmPtr[idx++] = pParam;
+        if(*pParam == 0)
+            break;
+        if(cnt >= maxArgs)
+            return PARSE_ERR_ARGS;
+
+        pWr = pParam;
+        ParmPtr[cnt++] = pWr;
+        quote = 0;
+        while(*pParam != 0 && (quote != 0 || (*pParam != ' ' && *pParam != '\t')))
+        {
+            if(*pParam == '\\' && quote != '\'' && pParam[1] != 0)
+            {
+                pParam++;
+                *pWr++ = *pParam++;
+            }
+            else if(quote != 0 && *pParam == quote)
+            {
+                quote = 0;
+                pParam++;
+            }
+            else if(quote == 0 && (*pParam == '"' || *pParam == '\''))
+                quote = *pParam++;
+            else
+                *pWr++ = *pParam++;
         }
+        if(quote != 0)
+            return PARSE_ERR_QUOTE;
+        if(*pParam != 0)
+            pParam++;
+        *pWr = 0;
     }
-    return idx;
+    if(cnt < maxArgs)
+        ParmPtr[cnt] = NULL;
+    return cnt;
 }
 
 void microBoxEsp::ExecCommand()
 {
-    bool found = false;
-    esp8266.println();
+    pTransport->StartCoalesce();
+    pTransport->println();
     if(bufPos > 0)
     {
-        uint8_t i=0;
-        uint8_t dstlen;
-        uint8_t srclen;
-        char *pParam;
-
         cmdBuf[bufPos] = 0;
-        pParam = strchr(cmdBuf, ' ');
-        if(pParam != NULL)
-        {
-            pParam++;
-            srclen = pParam - cmdBuf - 1;
-        }
-        else
-            srclen = bufPos;
-
+#if MB_FEATURE_HISTORY
         AddToHistory(cmdBuf);
         historyCursorPos = -1;
+#endif
+
+        ExecLine(cmdBuf);
+    }
+    if(!Busy())
+        ShowPrompt();
+    pTransport->EndCoalesce();
+}
+
+// load and bin read the following input themselves, a streaming
+// command shows the prompt when it is done
+bool microBoxEsp::Busy()
+{
+#if MB_FEATURE_DUMPLOAD
+    if(loadMode)
+        return true;
+#endif
+#if MB_FEATURE_BINARY
+    if(binMode != BIN_OFF)
+        return true;
+#endif
+#if MB_FEATURE_STREAM
+    if(streamCmd >= 0)
+        return true;
+#endif
+    return false;
+}
+
+bool microBoxEsp::InScript()
+{
+#if MB_FEATURE_SCRIPTS
+    return scriptDepth != 0;
+#else
+    return false;
+#endif
+}
+
+// Terminates the first command of pLine at the next ';' or '&&'
+// outside of quotes and returns the start of the following command or NULL.
+char *microBoxEsp::SplitCmdLine(char *pLine, bool *pAndNext)
+{
+    char quote = 0;
 
-        while(Cmds[i].cmdName != NULL && found == false)
+    *pAndNext = false;
+    while(*pLine != 0)
+    {
+        if(*pLine == '\\' && quote != '\'' && pLine[1] != 0)
+            pLine++;
+        else if(quote != 0)
         {
-            dstlen = strlen(Cmds[i].cmdName);
-            if(dstlen == srclen)
-            {
-                if(strncmp(cmdBuf, Cmds[i].cmdName, dstlen) == 0)
-                {
-                    (*Cmds[i].cmdFunc)(ParmPtr, ParseCmdParams(pParam));
-                    found = true;
-                    ShowPrompt();
-                }
-            }
-            i++;
+            if(*pLine == quote)
+                quote = 0;
         }
-        if(!found)
+        else if(*pLine == '"' || *pLine == '\'')
+            quote = *pLine;
+        else if(*pLine == ';')
         {
-            ErrorDir(F("/bin/sh"));
-            ShowPrompt();
+            *pLine = 0;
+            return pLine+1;
+        }
+        else if(pLine[0] == '&' && pLine[1] == '&')
+        {
+            *pAndNext = true;
+            *pLine = 0;
+            return pLine+2;
         }
+        pLine++;
     }
-    else
-        ShowPrompt();
+    return NULL;
 }
 
-void microBoxEsp::BlockreadSend()
+// Executes a command line, commands may be chained with ';' or '&&'
+// run false skips the first command, like a failed one before '&&'
+bool microBoxEsp::ExecLine(char *pLine, bool run)
 {
-    if(blockRead)
+    char *pNext;
+    bool andNext;
+    bool ok = true;
+
+    while(pLine != NULL)
     {
-        if(blockRead == 0xff)
-            blockRead = 0;
-        if(bufPos && (bufPos-blockRead) && (bufPos>blockRead) && (loginState == STATE_LOGIN_LOGGEDIN || loginState == STATE_LOGIN_USERNAME))
-            esp8266.write((uint8_t*)cmdBuf+blockRead, bufPos-blockRead);
-        blockRead = 0;
+#if MB_FEATURE_WATCH
+        if(watchMode)
+            break;
+#endif
+#if MB_FEATURE_BINARY
+        if(binMode != BIN_OFF)
+            break;
+#endif
+        pNext = SplitCmdLine(pLine, &andNext);
+        if(run)
+            ok = ExecSingle(pLine);
+#if MB_FEATURE_STREAM
+        if(streamCmd >= 0)
+        {
+            streamNext = pNext;
+            streamAndNext = andNext;
+            break;
+        }
+#endif
+        run = !andNext || ok;
+        pLine = pNext;
     }
+    return ok;
 }
 
-void microBoxEsp::cmdParser()
+bool microBoxEsp::ExecSingle(char *pCmd)
 {
-    uint8_t conState;
+    int16_t i;
+    uint8_t len;
+    char *pParam;
+    int16_t parCnt;
+#if MB_FEATURE_STREAM
+    bool sync = InScript();
+#endif
+#if MB_FEATURE_TMPFS
+    MbTransport *pOut = NULL;
+    const char *pTmp;
+#endif
+
+    while(*pCmd == ' ' || *pCmd == '\t')
+        pCmd++;
+    if(*pCmd == 0)
+        return true;
 
-    conState = esp8266.GetStatus();
-    if(conState == STATUS_ESP_CONNECTED && loginState == STATE_LOGIN_DISCONNECTED)
-    {
-        loginState = STATE_LOGIN_USERNAME;
-        esp8266.print(F("\xff\xfd\x01\xff\xfb\x01\xff\xfb\x03")); // Send telnet Do Echo, Suppress SGa, Will Echo
-        delay(1000);
-        strcpy(cmdBuf, machName);
-        strcat_P(cmdBuf, PSTR(" login: "));
-        esp8266.print(cmdBuf);
-        esp8266.clearBuffer();
-    }
-    else if(conState == STATUS_ESP_DISCONNECTED && loginState != STATE_LOGIN_DISCONNECTED)
+    pParam = pCmd;
+    while(*pParam != 0 && *pParam != ' ' && *pParam != '\t')
+        pParam++;
+    len = pParam - pCmd;
+    if(*pParam == 0)
+        pParam = NULL;
+
+    cmdError = false;
+    i = FindCmd(pCmd, len);
+    if(i == -1)
     {
-        loginState = STATE_LOGIN_DISCONNECTED;
-        esp8266.clearBuffer();
-        serAvail = 0;
-        bufPos = 0;
-        currentDir[0] = '/';
-        currentDir[1] = 0;
+        ErrorDir(F("/bin/sh"));
+        return false;
     }
 
-    if(serAvail == 0)
+    parCnt = ParseCmdParams(pParam);
+    if(parCnt < 0)
     {
-        BlockreadSend();
-        serAvail = esp8266.ReadResponse();
-        if(serAvail > 1)
-        {
-            if(bufPos)
-                blockRead = bufPos;
-            else
-                blockRead = 0xff;
-        }
+        PrintCmdName(i);
+        if(parCnt == PARSE_ERR_ARGS)
+            pTransport->println(F(": Too many arguments"));
         else
-            blockRead = 0;
+            pTransport->println(F(": Unterminated quote"));
+        return false;
     }
-
-    if(watchMode)
+#if MB_FEATURE_TMPFS
+    // cmd > /tmp/file, the command runs to the end into the file
+    if(parCnt >= 2 && strcmp_P(ParmPtr[parCnt-2], PSTR(">")) == 0 && (pTmp = TmpName(ParmPtr[parCnt-1])) != NULL)
     {
-        if(serAvail > 0)
+        if(!CanRedirect(i))
         {
-            watchMode = false;
-            csvMode = false;
+            cmdError = true;
+            PrintCmdName(i);
+            pTransport->println(F(": Output can not be redirected"));
+            return false;
         }
-        else
+        if(!TmpFs.Create(pTmp))
         {
-            if(isTimeout(&watchTimeout, 500))
-                Cat_int(cmdBuf);
-
-            return;
+            cmdError = true;
+            pTransport->println(F("sh: Can not create /tmp file"));
+            return false;
         }
+        parCnt -= 2;
+        ParmPtr[parCnt] = NULL;
+        pOut = pTransport;
+        pTransport = &TmpFs;
+#if MB_FEATURE_STREAM
+        sync = true;
+#endif
     }
-    while(serAvail > 0 && esp8266.SerialAvailable())
+#endif
+    streamState = 0;
+    streamMore = false;
+    CallCmd(i, parCnt);
+#if MB_FEATURE_STREAM
+    // Script lines are not kept, scripts run commands to the end
+    if(streamMore && !sync)
     {
-        unsigned char ch;
-        serAvail--;
-        ch = esp8266.read();
-
-        if(loginState == STATE_LOGIN_LOGGEDIN)
-            if(HandleEscSeq(ch))
-                continue;
-
-        if(ch == 0x7F || ch == 0x08)
-        {
-            if(bufPos > 0)
-            {
-                esp8266.clearBuffer(serAvail);
-                serAvail = 0;
-                BlockreadSend();
-                esp8266.SendHeader(6);
-                pSerial->write(ch);
-                pSerial->print(F(" \x1B[1D"));
-                esp8266.WaitForSendComplete();
-                bufPos--;
-                cmdBuf[bufPos] = 0;
-            }
-        }
-        else if(ch == '\t' && !blockRead && loginState == STATE_LOGIN_LOGGEDIN)
-        {
-            HandleTab();
-        }
-        else if(ch != '\r')
+        streamCmd = i;
+        streamParCnt = parCnt;
+        return true;
+    }
+#endif
+    while(streamMore)
+    {
+        streamMore = false;
+        CallCmd(i, parCnt);
+    }
+#if MB_FEATURE_TMPFS
+    if(pOut != NULL)
+    {
+        pTransport = pOut;
+        if(!TmpFs.Finish())
         {
-            if(bufPos < (MAX_CMD_BUF_SIZE-1))
-            {
-                if(ch != '\n')
-                {
-                    if(!blockRead && (loginState == STATE_LOGIN_LOGGEDIN || loginState == STATE_LOGIN_USERNAME))
-                        esp8266.write((uint8_t*)&ch, 1);
-                    cmdBuf[bufPos++] = ch;
-                    cmdBuf[bufPos] = 0;
-                }
-            }
-            if(ch == '\n')
-            {
-                BlockreadSend();
-                if(loginState == STATE_LOGIN_LOGGEDIN)
-                    ExecCommand();
-                else
-                    HandleLogin();
-                bufPos = 0;
-                //			 cmdBuf[bufPos] = 0;
-            }
+            cmdError = true;
+            pTransport->println(F("sh: /tmp full"));
         }
     }
+#endif
+    return !cmdError;
 }
 
-void microBoxEsp::PasswordPrompt()
+// Command indices count the built-ins first, then Cmds[]
+void microBoxEsp::CallCmd(uint8_t idx, uint8_t parCnt)
 {
-    esp8266.println();
-    esp8266.print(F("Password:"));
+    void (*cmdFunc)(char **param, uint8_t parCnt);
+#if MB_FEATURE_PROFILER
+    unsigned long start = micros();
+    uint32_t dur;
+#endif
+
+    if(idx < BUILTIN_NUM)
+        memcpy_P(&cmdFunc, &Builtins[idx].cmdFunc, sizeof(cmdFunc));
+    else
+        cmdFunc = Cmds[idx - BUILTIN_NUM].cmdFunc;
+    (*cmdFunc)(ParmPtr, parCnt);
+#if MB_FEATURE_PROFILER
+    dur = micros() - start;
+    cmdStats[idx].calls++;
+    cmdStats[idx].timeUs += dur;
+    if(dur > cmdStats[idx].maxUs)
+        cmdStats[idx].maxUs = dur;
+#endif
 }
 
-void microBoxEsp::HandleLogin()
+// Index of the command pCmd (len chars), -1 if there is none
+int16_t microBoxEsp::FindCmd(const char *pCmd, uint8_t len)
 {
-    if(loginState == STATE_LOGIN_USERNAME)
+    uint8_t i;
+
+    for(i=0;i<BUILTIN_NUM;i++)
     {
-        if(strcmp_P(cmdBuf, PSTR("root")) == 0)
-        {
-            loginState++;
-        }
-        else
-        {
-            loginState = STATE_LOGIN_WRONG_USER_PASSWORD1;
+        if(strlen_P(Builtins[i].cmdName) == len && strncmp_P(pCmd, Builtins[i].cmdName, len) == 0)
+            return i;
+    }
+    for(i=0;Cmds[i].cmdName != NULL;i++)
+    {
+        if(strlen(Cmds[i].cmdName) == len && strncmp(pCmd, Cmds[i].cmdName, len) == 0)
+            return BUILTIN_NUM + i;
+    }
+    return -1;
+}
+
+uint8_t microBoxEsp::CmdCount()
+{
+    uint8_t i=0;
+
+    while(Cmds[i].cmdName != NULL)
+        i++;
+    return BUILTIN_NUM + i;
+}
+
+// Index of the command at position pos in alphabetical order. The
+// built-ins and Cmds[] are sorted each, they are merged here.
+uint8_t microBoxEsp::CmdSorted(uint8_t pos)
+{
+    uint8_t b = 0;
+    uint8_t u = 0;
+
+    while(true)
+    {
+        if(Cmds[u].cmdName != NULL && (b == BUILTIN_NUM || strcmp_P(Cmds[u].cmdName, Builtins[b].cmdName) < 0))
+        {
+            if(pos-- == 0)
+                return BUILTIN_NUM + u;
+            u++;
+        }
+        else
+        {
+            if(pos-- == 0)
+                return b;
+            b++;
+        }
+    }
+}
+
+char microBoxEsp::CmdChar(uint8_t idx, uint8_t i)
+{
+    if(idx < BUILTIN_NUM)
+        return pgm_read_byte_near(&Builtins[idx].cmdName[i]);
+    return Cmds[idx - BUILTIN_NUM].cmdName[i];
+}
+
+void microBoxEsp::PrintCmdName(uint8_t idx)
+{
+    if(idx < BUILTIN_NUM)
+        pTransport->print((const __FlashStringHelper*)Builtins[idx].cmdName);
+    else
+        pTransport->print(Cmds[idx - BUILTIN_NUM].cmdName);
+}
+
+void microBoxEsp::More(uint16_t state)
+{
+    pActive->streamState = state;
+    pActive->streamMore = true;
+}
+
+uint16_t microBoxEsp::State()
+{
+    return pActive->streamState;
+}
+
+#if MB_FEATURE_STREAM
+// One more pass of a suspended command. Its arguments stay in cmdBuf
+// because input is not read meanwhile. When it is done the rest of
+// the command line runs and the prompt is shown.
+void microBoxEsp::StreamStep()
+{
+    pTransport->StartCoalesce();
+    streamMore = false;
+    CallCmd(streamCmd, streamParCnt);
+    if(!streamMore)
+    {
+        streamCmd = -1;
+        if(streamNext != NULL)
+            ExecLine(streamNext, !streamAndNext || !cmdError);
+        if(!Busy())
+            ShowPrompt();
+    }
+    pTransport->EndCoalesce();
+}
+#endif
+
+#if MB_FEATURE_SCRIPTS
+int8_t microBoxEsp::GetScriptIdx(char *pName)
+{
+    int8_t i=0;
+
+    if(strncmp_P(pName, PSTR("/etc/"), 5) == 0)
+        pName += 5;
+    while(i < MAX_SCRIPT_NUM && Scripts[i].scriptName != NULL)
+    {
+        if(strcmp(Scripts[i].scriptName, pName) == 0)
+            return i;
+        i++;
+    }
+    return -1;
+}
+
+// Runs all lines, false if one of them failed. A line longer than
+// the command buffer stops the script instead of running a cut off
+// command. Each nesting level copies its lines into its own part of
+// scriptLines, the commands keep pointers into them while they run.
+bool microBoxEsp::RunScript(uint8_t idx)
+{
+    char *line = scriptLines + scriptDepth * cmdBufSize;
+    const prog_char *pScript = Scripts[idx].script;
+    uint8_t pos = 0;
+    bool ok = true;
+    char ch;
+
+    scriptDepth++;
+    do
+    {
+        ch = pgm_read_byte_near(pScript++);
+        if(ch == '\n' || ch == 0)
+        {
+            line[pos] = 0;
+            if(pos)
+                ok &= ExecLine(line);
+            pos = 0;
+        }
+        else if(pos < (cmdBufSize-1))
+            line[pos++] = ch;
+        else
+        {
+            pTransport->print(F("sh: "));
+            pTransport->print(Scripts[idx].scriptName);
+            pTransport->println(F(": Line too long"));
+            ok = false;
+            break;
+        }
+#if MB_FEATURE_WATCH
+        if(watchMode)
+            break;
+#endif
+#if MB_FEATURE_BINARY
+        if(binMode != BIN_OFF)
+            break;
+#endif
+    }while(ch != 0);
+    scriptDepth--;
+
+    return ok;
+}
+#endif
+
+// Input is echoed except for passwords and load data
+bool microBoxEsp::EchoInput()
+{
+#if MB_FEATURE_DUMPLOAD
+    if(loadMode)
+        return false;
+#endif
+#if MB_FEATURE_BINARY
+    if(binMode != BIN_OFF)
+        return false;
+#endif
+    return !echoOff && (loginState == STATE_LOGIN_LOGGEDIN || loginState == STATE_LOGIN_USERNAME);
+}
+
+void microBoxEsp::BlockreadSend()
+{
+    if(blockRead)
+    {
+        if(blockRead == 0xff)
+            blockRead = 0;
+        if(bufPos && (bufPos-blockRead) && (bufPos>blockRead) && EchoInput())
+            pTransport->write((uint8_t*)cmdBuf+blockRead, bufPos-blockRead);
+        blockRead = 0;
+    }
+}
+
+void microBoxEsp::cmdParser()
+{
+#if MB_FEATURE_PROFILER
+    unsigned long start = micros();
+    uint32_t dur;
+#endif
+
+    if(cmdBuf == NULL)
+        return;
+    pActive = this;
+#if MB_FEATURE_RECORDER
+    if(recActive)
+        RecordSample();
+#endif
+    ParseInput();
+
+#if MB_FEATURE_PROFILER
+    dur = micros() - start;
+    if(dur < parseMinUs)
+        parseMinUs = dur;
+    if(dur > parseMaxUs)
+        parseMaxUs = dur;
+    // Halve both so the average keeps working when the sum would overflow
+    if(parseSumUs > 0x80000000UL)
+    {
+        parseSumUs >>= 1;
+        parseCnt >>= 1;
+    }
+    parseSumUs += dur;
+    parseCnt++;
+
+    loopCnt++;
+    if(isTimeout(&loopTimeout, 1000))
+    {
+        loopHz = loopCnt;
+        loopCnt = 0;
+    }
+#endif
+}
+
+void microBoxEsp::ParseInput()
+{
+    uint8_t conState;
+
+    conState = pTransport->GetStatus();
+    if(conState == STATUS_ESP_CONNECTED && loginState == STATE_LOGIN_DISCONNECTED)
+    {
+#if MB_FEATURE_LOGIN
+        loginState = STATE_LOGIN_USERNAME;
+#else
+        loginState = STATE_LOGIN_LOGGEDIN;
+#endif
+        pTransport->StartCoalesce();
+        if(pTransport->IsTelnet())
+        {
+            // Offer linemode, the answer is handled in TelnetOption().
+            // Until then run in character mode with server echo.
+            pTransport->print(F("\xff\xfd\x22\xff\xfb\x01\xff\xfb\x03")); // Send telnet Do Linemode, Will Echo, Will Suppress GA
+        }
+#if MB_FEATURE_LOGIN
+        pTransport->print(machName);
+        pTransport->print(F(" login: "));
+#else
+        ShowPrompt();
+#endif
+        pTransport->EndCoalesce();
+    }
+    else if(conState == STATUS_ESP_DISCONNECTED && loginState != STATE_LOGIN_DISCONNECTED)
+    {
+        loginState = STATE_LOGIN_DISCONNECTED;
+        pTransport->clearBuffer();
+#if MB_FEATURE_DUMPLOAD
+        loadMode = false;
+        lineCut = false;
+        pendingCnt = 0;
+#endif
+#if MB_FEATURE_BINARY
+        binMode = BIN_OFF;
+#endif
+#if MB_FEATURE_TRANSACTION
+        txnActive = false;      // Staged values are dropped
+#endif
+#if MB_FEATURE_STREAM
+        streamCmd = -1;
+#endif
+        telnetState = TELNET_STATE_DATA;
+        lineMode = false;
+        echoOff = false;
+        serAvail = 0;
+        bufPos = 0;
+        curNode = NODE_ROOT;
+    }
+
+    if(serAvail == 0)
+    {
+        BlockreadSend();
+        serAvail = pTransport->Receive();
+        if(serAvail > 1)
+        {
+            if(bufPos)
+                blockRead = bufPos;
+            else
+                blockRead = 0xff;
+        }
+        else
+            blockRead = 0;
+    }
+
+#if MB_FEATURE_WATCH
+    if(watchMode)
+    {
+        if(serAvail > 0)
+        {
+            watchMode = false;
+            csvMode = false;
+            if(watchDrops != 0)
+            {
+                pTransport->StartCoalesce();
+                pTransport->println();
+                pTransport->print(F("watch: "));
+                pTransport->print((int)watchDrops);
+                pTransport->println(F(" dropped"));
+                pTransport->EndCoalesce();
+            }
+        }
+        else
+        {
+            if(watchWindow != 0)
+                WatchAggregate();
+            else if(watchOnChange)
+                WatchChanges();
+            else if(isTimeout(&watchTimeout, watchPace))
+                WatchSend();
+
+            return;
+        }
+    }
+#endif
+#if MB_FEATURE_STREAM
+    if(streamCmd >= 0)
+    {
+        StreamStep();
+        return;
+    }
+#endif
+#if MB_FEATURE_BINARY
+    if(binMode != BIN_OFF)
+        BinPoll();
+#endif
+    while(serAvail > 0 && pTransport->available())
+    {
+#if MB_FEATURE_STREAM
+        // Further input waits until the command is done
+        if(streamCmd >= 0)
+            break;
+#endif
+        unsigned char ch;
+        serAvail--;
+        ch = pTransport->read();
+
+        if(telnetState != TELNET_STATE_DATA || ch == TELNET_IAC)
+            if(pTransport->IsTelnet() && HandleTelnet(ch))
+                continue;
+
+#if MB_FEATURE_BINARY
+        if(binMode != BIN_OFF)
+        {
+            BinInput(ch);
+            continue;
+        }
+#endif
+
+        if(ch == 0)
+            continue;
+
+#if MB_FEATURE_COMPLETION
+        if(ch != '\t')
+            tabPressed = false;
+#endif
+
+        if(loginState == STATE_LOGIN_LOGGEDIN)
+            if(HandleEscSeq(ch))
+                continue;
+
+        if(ch == 0x7F || ch == 0x08)
+        {
+            if(bufPos > 0)
+            {
+                pTransport->clearBuffer(serAvail);
+                serAvail = 0;
+                BlockreadSend();
+                if(!echoOff)
+                {
+                    pTransport->StartCoalesce();
+                    pTransport->write((uint8_t*)&ch, 1);
+                    pTransport->print(F(" \x1B[1D"));
+                    pTransport->EndCoalesce();
+                }
+                bufPos--;
+                cmdBuf[bufPos] = 0;
+            }
+        }
+        else if(ch == '\t' && (!blockRead || lineMode) && loginState == STATE_LOGIN_LOGGEDIN)
+        {
+#if MB_FEATURE_COMPLETION
+            HandleTab();
+#endif
+        }
+        else if(ch != '\r')
+        {
+            if(bufPos < (cmdBufSize-1))
+            {
+                if(ch != '\n')
+                {
+                    if(!blockRead && EchoInput())
+                        pTransport->write((uint8_t*)&ch, 1);
+                    cmdBuf[bufPos++] = ch;
+                    cmdBuf[bufPos] = 0;
+                }
+            }
+#if MB_FEATURE_DUMPLOAD
+            else if(ch != '\n')
+                lineCut = true;
+#endif
+            if(ch == '\n')
+            {
+                BlockreadSend();
+#if MB_FEATURE_DUMPLOAD
+                if(loadMode)
+                {
+                    cmdBuf[bufPos] = 0;
+                    // The cut off rest of a value must not be applied
+                    if(lineCut)
+                        loadErrors++;
+                    else if(bufPos)
+                        LoadLine(cmdBuf);
+                    else
+                        EndLoad();
+                }
+                else
+#endif
+                if(loginState == STATE_LOGIN_LOGGEDIN)
+                    ExecCommand();
+#if MB_FEATURE_LOGIN
+                else
+                    HandleLogin();
+#endif
+                bufPos = 0;
+#if MB_FEATURE_DUMPLOAD
+                lineCut = false;
+#endif
+                //			 cmdBuf[bufPos] = 0;
+            }
+        }
+    }
+}
+
+#if MB_FEATURE_LOGIN
+void microBoxEsp::PasswordPrompt()
+{
+    SetTelnetEcho(true);
+    pTransport->println();
+    pTransport->print(F("Password:"));
+}
+
+void microBoxEsp::HandleLogin()
+{
+    if(loginState == STATE_LOGIN_USERNAME)
+    {
+        if(strcmp_P(cmdBuf, PSTR("root")) == 0)
+        {
+            loginState++;
+        }
+        else
+        {
+            loginState = STATE_LOGIN_WRONG_USER_PASSWORD1;
+        }
+
+        PasswordPrompt();
+    }
+    else
+    {
+        if(loginState < STATE_LOGIN_LOGGEDIN && strcmp(cmdBuf, password) == 0)
+        {
+            loginState = STATE_LOGIN_LOGGEDIN;
+            SetTelnetEcho(false);
+            pTransport->println();
+            ShowPrompt();
+        }
+        else
+        {
+            loginState++;
+            if(loginState != STATE_LOGIN_LOGGEDIN && loginState < STATE_LOGIN_USER_ERROR)
+                PasswordPrompt();
+            else
+                Exit();
+        }
+    }
+}
+#endif
+
+// Filters telnet commands out of the input stream
+bool microBoxEsp::HandleTelnet(unsigned char ch)
+{
+    switch(telnetState)
+    {
+    case TELNET_STATE_DATA:
+        telnetState = TELNET_STATE_IAC;
+        return true;
+    case TELNET_STATE_IAC:
+        if(ch == TELNET_IAC)
+        {
+            // Escaped 0xff data byte
+            telnetState = TELNET_STATE_DATA;
+            return false;
+        }
+        if(ch >= TELNET_WILL)
+        {
+            telnetCmd = ch;
+            telnetState = TELNET_STATE_OPT;
+        }
+        else if(ch == TELNET_SB)
+            telnetState = TELNET_STATE_SB;
+        else
+            telnetState = TELNET_STATE_DATA;
+        return true;
+    case TELNET_STATE_OPT:
+        telnetState = TELNET_STATE_DATA;
+        TelnetOption(telnetCmd, ch);
+        return true;
+    case TELNET_STATE_SB:
+        if(ch == TELNET_IAC)
+            telnetState = TELNET_STATE_SB_IAC;
+        return true;
+    case TELNET_STATE_SB_IAC:
+        if(ch == TELNET_SE)
+            telnetState = TELNET_STATE_DATA;
+        else
+            telnetState = TELNET_STATE_SB;
+        return true;
+    }
+    return false;
+}
+
+void microBoxEsp::TelnetOption(uint8_t cmd, uint8_t opt)
+{
+    if(opt == TELNET_OPT_LINEMODE)
+    {
+        if(cmd == TELNET_WILL && !lineMode)
+        {
+            // Client edits and echoes lines itself, only tab is forwarded at once
+            const uint8_t lmMode[] = {TELNET_IAC, TELNET_SB, TELNET_OPT_LINEMODE, TELNET_LM_MODE, TELNET_LM_MODE_EDIT, TELNET_IAC, TELNET_SE};
+            const uint8_t lmForward[] = {TELNET_IAC, TELNET_SB, TELNET_OPT_LINEMODE, TELNET_DO, TELNET_LM_FORWARDMASK, 0x00, 0x40, TELNET_IAC, TELNET_SE};
+
+            lineMode = true;
+            echoOff = true;
+            pTransport->StartCoalesce();
+            pTransport->write(lmMode, sizeof(lmMode));
+            pTransport->write(lmForward, sizeof(lmForward));
+            if(loginState < STATE_LOGIN_PASSWORD1 || loginState == STATE_LOGIN_LOGGEDIN)
+                SendTelnetCmd(TELNET_WONT, TELNET_OPT_ECHO);
+            pTransport->EndCoalesce();
+        }
+    }
+    else if(opt == TELNET_OPT_ECHO)
+    {
+        if(cmd == TELNET_DONT)
+            echoOff = true;
+        else if(cmd == TELNET_DO && !lineMode)
+            echoOff = false;
+        else if(cmd == TELNET_WILL)
+            SendTelnetCmd(TELNET_DONT, opt);
+    }
+    else if(opt != TELNET_OPT_SGA)
+    {
+        if(cmd == TELNET_DO)
+            SendTelnetCmd(TELNET_WONT, opt);
+        else if(cmd == TELNET_WILL)
+            SendTelnetCmd(TELNET_DONT, opt);
+    }
+}
+
+void microBoxEsp::SendTelnetCmd(uint8_t cmd, uint8_t opt)
+{
+    uint8_t buf[3];
+
+    buf[0] = TELNET_IAC;
+    buf[1] = cmd;
+    buf[2] = opt;
+    pTransport->write(buf, 3);
+}
+
+// In linemode the client echoes, except while the password is typed
+void microBoxEsp::SetTelnetEcho(bool serverEcho)
+{
+    if(lineMode)
+        SendTelnetCmd(serverEcho ? TELNET_WILL : TELNET_WONT, TELNET_OPT_ECHO);
+}
+
+bool microBoxEsp::HandleEscSeq(unsigned char ch)
+{
+    bool ret = false;
+
+    if(ch == 27)
+    {
+        escSeq = ESC_STATE_START;
+        ret = true;
+    }
+    else if(escSeq == ESC_STATE_START)
+    {
+        if(ch == 0x5B)
+        {
+            escSeq = ESC_STATE_CODE;
+            ret = true;
+        }
+        else
+            escSeq = ESC_STATE_NONE;
+    }
+    else if(escSeq == ESC_STATE_CODE)
+    {
+#if MB_FEATURE_HISTORY
+        if(ch == 0x41) // Cursor Up
+        {
+            HistoryUp();
+        }
+        else if(ch == 0x42) // Cursor Down
+        {
+            HistoryDown();
+        }
+#endif
+        // Cursor Right/Left are ignored
+        escSeq = ESC_STATE_NONE;
+        blockRead = 0;
+        ret = true;
+    }
+    return ret;
+}
+
+
+char microBoxEsp::NodeChar(uint16_t node, uint8_t pos)
+{
+    if(pos >= Nodes[node].nameLen)
+        return 0;
+    if(Nodes[node].flags & NODE_FLASH)
+        return pgm_read_byte_near(Nodes[node].name + pos);
+    return Nodes[node].name[pos];
+}
+
+// Completion works on the children of a directory node, or on the
+// commands when dir is -1. pos is a node index or the position of a
+// command in alphabetical order.
+char microBoxEsp::EntryChar(int16_t dir, uint16_t pos, uint8_t i)
+{
+    if(dir < 0)
+        return CmdChar(CmdSorted(pos), i);
+    return NodeChar(pos, i);
+}
+
+int8_t microBoxEsp::EntryCmp(int16_t dir, uint16_t pos, const char *pStr, uint8_t len)
+{
+    uint8_t i;
+    char ch;
+
+    for(i=0;i<len;i++)
+    {
+        ch = EntryChar(dir, pos, i);
+        if(ch != pStr[i])
+            return (uint8_t)ch < (uint8_t)pStr[i] ? -1 : 1;
+        if(ch == 0)
+            break;
+    }
+    return 0;
+}
+
+#if MB_FEATURE_COMPLETION
+void microBoxEsp::PrintEntryName(int16_t dir, uint16_t pos)
+{
+    if(dir < 0)
+        PrintCmdName(CmdSorted(pos));
+    else
+        PrintNodeName(pos);
+}
+#endif
+
+// Binary search for the first entry starting with >= pStr (upper == false)
+// or the first entry behind all entries starting with pStr (upper == true)
+uint16_t microBoxEsp::FindPrefix(int16_t dir, const char *pStr, uint8_t len, bool upper)
+{
+    uint16_t lo = 0;
+    uint16_t hi = 0;
+    uint16_t mid;
+    int8_t cmp;
+
+    if(dir < 0)
+        hi = CmdCount();
+    else
+    {
+        lo = Nodes[dir].idx;
+        hi = lo + Nodes[dir].childCnt;
+    }
+
+    while(lo < hi)
+    {
+        mid = lo + (hi-lo)/2;
+        cmp = EntryCmp(dir, mid, pStr, len);
+        if(cmp < 0 || (upper && cmp == 0))
+            lo = mid+1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+#if MB_FEATURE_COMPLETION
+void microBoxEsp::HandleTab()
+{
+    char *pParam = NULL;
+    char *pFile;
+    int16_t dir = -1;
+    uint16_t first, last, pos;
+    uint8_t i, inlen, matchlen;
+    char ch;
+
+    for(i=0;i<bufPos;i++)
+    {
+        if(cmdBuf[i] == ' ')
+            pParam = cmdBuf+i;
+    }
+    if(pParam != NULL)
+    {
+        pParam++;
+        pFile = GetFile(pParam);
+        dir = ResolvePath(curNode, pParam, pFile - pParam);
+        if(dir < 0 || !(Nodes[dir].flags & NODE_DIR))
+            return;
+        if(dir == NODE_BIN)
+            dir = -1;
+    }
+    else if(bufPos)
+        pFile = cmdBuf;
+    else
+        return;
+
+    inlen = strlen(pFile);
+    first = FindPrefix(dir, pFile, inlen, false);
+    last = FindPrefix(dir, pFile, inlen, true);
+    if(first == last)
+        return;
+    last--;
+
+    // All matches share the prefix of the first and the last match
+    matchlen = inlen;
+    while((ch = EntryChar(dir, first, matchlen)) != 0 && (first == last || ch == EntryChar(dir, last, matchlen)))
+        matchlen++;
+
+    pTransport->StartCoalesce();
+    if(matchlen > inlen)
+    {
+        pos = bufPos;
+        if((bufPos + matchlen - inlen + 1) < cmdBufSize)
+        {
+            for(i=inlen;i<matchlen;i++)
+                cmdBuf[bufPos++] = EntryChar(dir, first, i);
+            if(first == last && dir >= 0 && (Nodes[first].flags & NODE_DIR))
+                cmdBuf[bufPos++] = '/';
+            cmdBuf[bufPos] = 0;
+            pTransport->print(cmdBuf + pos);
+        }
+    }
+    else if(first != last && tabPressed)
+    {
+        // Second tab without progress lists all candidates
+        pTransport->println();
+        for(pos=first;pos<=last;pos++)
+        {
+            PrintEntryName(dir, pos);
+            pTransport->print(F("  "));
+        }
+        pTransport->println();
+        ShowPrompt();
+        pTransport->print(cmdBuf);
+    }
+    pTransport->EndCoalesce();
+    tabPressed = true;
+}
+#endif
+
+#if MB_FEATURE_HISTORY
+void microBoxEsp::HistoryUp()
+{
+    if(historyBufSize == 0 || historyWrPos == 0)
+        return;
+
+    if(historyCursorPos == -1)
+        historyCursorPos = historyWrPos-2;
+
+    while(historyBuf[historyCursorPos] != 0 && historyCursorPos > 0)
+    {
+        historyCursorPos--;
+    }
+    if(historyCursorPos > 0)
+        historyCursorPos++;
+
+    strcpy(cmdBuf, historyBuf+historyCursorPos);
+    HistoryPrintHlpr();
+    if(historyCursorPos > 1)
+        historyCursorPos -= 2;
+}
+
+void microBoxEsp::HistoryDown()
+{
+    int pos;
+    if(historyCursorPos != -1 && historyCursorPos != historyWrPos-2)
+    {
+        pos = historyCursorPos+2;
+        pos += strlen(historyBuf+pos) + 1;
+
+        strcpy(cmdBuf, historyBuf+pos);
+        HistoryPrintHlpr();
+        historyCursorPos = pos - 2;
+    }
+}
+
+void microBoxEsp::HistoryPrintHlpr()
+{
+    uint8_t i;
+    uint8_t len;
+
+    len = strlen(cmdBuf);
+
+    pTransport->StartCoalesce();
+    for(i=0;i<bufPos;i++)
+        pTransport->print(F("\b"));
+    pTransport->print(cmdBuf);
+    if(len<bufPos)
+    {
+        pTransport->print(F("\x1B[K"));
+    }
+    pTransport->EndCoalesce();
+    bufPos = len;
+}
+
+void microBoxEsp::AddToHistory(char *buf)
+{
+    uint8_t len;
+    int blockStart = 0;
+
+    len = strlen(buf);
+    // A line longer than the whole history is not kept
+    if(historyBufSize > 0 && len+2 <= historyBufSize)
+    {
+        if(historyWrPos+len+1 >= historyBufSize)
+        {
+            while(historyWrPos+len+1-blockStart >= historyBufSize)
+            {
+                blockStart += strlen(historyBuf + blockStart) + 1;
+            }
+            memmove(historyBuf, historyBuf+blockStart, historyWrPos-blockStart);
+            historyWrPos -= blockStart;
+        }
+        strcpy(historyBuf+historyWrPos, buf);
+        historyWrPos += len+1;
+        historyBuf[historyWrPos] = 0;
+    }
+}
+#endif
+
+void microBoxEsp::ErrorDir(const __FlashStringHelper *cmd)
+{
+    cmdError = true;
+    pTransport->print(cmd);
+    pTransport->println(F(": File or directory not found\n"));
+}
+
+int16_t microBoxEsp::GetChild(uint16_t dir, const char *pName, uint8_t len)
+{
+    uint16_t node;
+
+    node = FindPrefix(dir, pName, len, false);
+    if(node < Nodes[dir].idx + Nodes[dir].childCnt && Nodes[node].nameLen == len && EntryCmp(dir, node, pName, len) == 0)
+        return node;
+    return -1;
+}
+
+// Walks the first len characters of pPath from node start, or from
+// the root for absolute paths. Returns the node or -1.
+int16_t microBoxEsp::ResolvePath(int16_t start, const char *pPath, uint8_t len)
+{
+    int16_t node = start;
+    uint8_t seg;
+
+    if(len > 0 && pPath[0] == '/')
+        node = NODE_ROOT;
+
+    while(len > 0)
+    {
+        if(*pPath == '/')
+        {
+            pPath++;
+            len--;
+            continue;
+        }
+        seg = 0;
+        while(seg < len && pPath[seg] != '/')
+            seg++;
+
+        if(seg == 2 && pPath[0] == '.' && pPath[1] == '.')
+            node = Nodes[node].parent;
+        else if(!(seg == 1 && pPath[0] == '.'))
+        {
+            if(!(Nodes[node].flags & NODE_DIR))
+                return -1;
+            node = GetChild(node, pPath, seg);
+            if(node < 0)
+                return -1;
+        }
+        pPath += seg;
+        len -= seg;
+    }
+    return node;
+}
+
+void microBoxEsp::PrintNodeName(uint16_t node)
+{
+    if(Nodes[node].flags & NODE_FLASH)
+        pTransport->print((const __FlashStringHelper*)Nodes[node].name);
+    else
+        pTransport->write((const uint8_t*)Nodes[node].name, Nodes[node].nameLen);
+}
+
+void microBoxEsp::PrintPath(uint16_t node)
+{
+    if(node == NODE_ROOT)
+    {
+        pTransport->print(F("/"));
+        return;
+    }
+    if(Nodes[node].parent != NODE_ROOT)
+        PrintPath(Nodes[node].parent);
+    pTransport->print(F("/"));
+    PrintNodeName(node);
+}
+
+char *microBoxEsp::GetFile(char *pParam)
+{
+    char *file;
+    char *t;
+
+    file = pParam;
+    while((t=strchr(file, '/')) != NULL)
+    {
+        file = t+1;
+    }
+    return file;
+}
+
+void microBoxEsp::ListDirHlp(bool dir, const char *name, bool listLong, bool rw, uint16_t len)
+{
+    char mode[4];
+
+    pTransport->StartCoalesce();
+    if(listLong)
+    {
+        mode[0] = dir ? 'd' : '-';
+        mode[1] = 'r';
+        mode[2] = rw ? 'w' : '-';
+        mode[3] = 0;
+
+        pTransport->print(mode);
+        pTransport->print(F("xr-xr-x\t2 root\troot\t"));
+        pTransport->print((int)len);
+        pTransport->print(F(" "));
+        pTransport->print((const __FlashStringHelper*)fileDate);
+        pTransport->print(F(" "));
+    }
+    if(name != NULL)
+        pTransport->println(name);
+    pTransport->EndCoalesce();
+}
+
+void microBoxEsp::ListNode(uint16_t node, bool listLong)
+{
+    if(Nodes[node].flags & NODE_DIR)
+        ListDirHlp(true, NULL, listLong);
+#if MB_FEATURE_PROFILER
+    else if(Nodes[node].flags & NODE_PROC)
+        ListDirHlp(false, NULL, listLong, Nodes[node].idx == PROC_RESET, 0);
+#endif
+    else
+    {
+        PARAM_ENTRY *pEntry = &Params[Nodes[node].idx];
+
+        ListDirHlp(false, NULL, listLong, pEntry->parType&PARTYPE_RW, ParamSize(Nodes[node].idx));
+    }
+    PrintNodeName(node);
+}
+
+// ls/ll [-o offset] [-n count] [path]
+// Lists count entries starting at entry offset, all by default.
+void microBoxEsp::ListDir(char **pParam, uint8_t parCnt, bool listLong)
+{
+    uint8_t i=0;
+    int16_t node = curNode;
+    uint16_t child;
+    uint16_t first = 0;
+    uint16_t last = 0xffff;
+#if MB_FEATURE_TMPFS
+    const char *pName;
+    const uint8_t *pData;
+    uint16_t size;
+#endif
+
+    while(i+1 < parCnt && pParam[i][0] == '-')
+    {
+        if(strcmp_P(pParam[i], PSTR("-o")) == 0)
+            first = atol(pParam[i+1]);
+        else if(strcmp_P(pParam[i], PSTR("-n")) == 0)
+            last = atol(pParam[i+1]);
+        else
+            break;
+        i += 2;
+    }
+    if(last != 0xffff)
+        last = (first + last < 0xffff) ? first + last : 0xffff;
+    pParam += i;
+    parCnt -= i;
+    i = 0;
+
+    if(parCnt > 1 || (parCnt == 1 && pParam[0][0] == '-'))
+    {
+        cmdError = true;
+        pTransport->print(listLong ? F("ll") : F("ls"));
+        pTransport->println(F(": Usage [-o offset] [-n count] [path]"));
+        return;
+    }
+
+    if(parCnt != 0)
+    {
+        node = ResolvePath(curNode, pParam[0], strlen(pParam[0]));
+#if MB_FEATURE_TMPFS
+        if(node < 0 && (pName = TmpName(pParam[0])) != NULL && TmpFs.Open(pName, &pData, &size))
+        {
+            ListDirHlp(false, pName, listLong, true, size);
+            return;
+        }
+#endif
+        if(node < 0)
+        {
+            if(listLong)
+                ErrorDir(F("ll"));
+            else
+                ErrorDir(F("ls"));
+            return;
+        }
+    }
+
+    if(node == NODE_BIN)
+    {
+        for(i=0;i<CmdCount();i++)
+        {
+            if(i >= first && i < last)
+            {
+                ListDirHlp(false, NULL, listLong);
+                PrintCmdName(CmdSorted(i));
+                pTransport->println();
+            }
+        }
+    }
+#if MB_FEATURE_SCRIPTS
+    else if(node == NODE_ETC)
+    {
+        while(i < MAX_SCRIPT_NUM && Scripts[i].scriptName != NULL)
+        {
+            if(i >= first && i < last)
+                ListDirHlp(false, Scripts[i].scriptName, listLong, false, strlen_P(Scripts[i].script));
+            i++;
+        }
+    }
+#endif
+#if MB_FEATURE_TMPFS
+    else if(node == NODE_TMP)
+    {
+        while(TmpFs.GetFile(i, &pName, &pData, &size))
+        {
+            if(i >= first && i < last)
+                ListDirHlp(false, pName, listLong, true, size);
+            i++;
+        }
+    }
+#endif
+    else if(Nodes[node].flags & NODE_DIR)
+    {
+        // STREAM_LINES entries per call, State() is the next entry
+        if(last > Nodes[node].childCnt)
+            last = Nodes[node].childCnt;
+        child = first + State();
+        for(i=0;child<last && i<STREAM_LINES;child++,i++)
+        {
+            ListNode(Nodes[node].idx + child, listLong);
+            if(node == NODE_ROOT && !listLong)
+                pTransport->print(F("\t"));
+            else
+                pTransport->println();
+        }
+        if(child < last)
+            More(child - first);
+        else if(node == NODE_ROOT && !listLong)
+            pTransport->println();
+    }
+    else
+    {
+        ListNode(node, listLong);
+        pTransport->println();
+    }
+}
+
+void microBoxEsp::ChangeDir(char **pParam, uint8_t parCnt)
+{
+    int16_t node;
+
+    if(pParam[0] != NULL)
+    {
+        node = ResolvePath(curNode, pParam[0], strlen(pParam[0]));
+        if(node >= 0 && (Nodes[node].flags & NODE_DIR))
+        {
+            curNode = node;
+            return;
+        }
+    }
+    ErrorDir(F("cd"));
+}
+
+#if MB_FEATURE_GETCACHE
+void microBoxEsp::SetMaxAge(const PARAM_AGE *pTable)
+{
+    pAges = pTable;
+    InvalidateCache();
+}
+
+// maxAge of a parameter from the SetMaxAge() table, 0 if it has none
+uint16_t microBoxEsp::MaxAge(uint16_t idx)
+{
+    const PARAM_AGE *pAge;
+
+    if(pAges == NULL)
+        return 0;
+    for(pAge=pAges;pAge->pParam != NULL;pAge++)
+    {
+        if(pAge->pParam == Params[idx].pParam)
+            return pAge->maxAge;
+    }
+    return 0;
+}
+
+// Marks all cached getFunc results as stale, 0 is skipped so
+// entries that were never read stay stale
+void microBoxEsp::InvalidateCache()
+{
+    if(++getGen == 0)
+        getGen = 1;
+}
+#endif
+
+void microBoxEsp::CallGetFunc(uint16_t idx)
+{
+    PARAM_ENTRY *pEntry = &Params[idx];
+#if MB_FEATURE_GETCACHE
+    unsigned long now;
+    uint16_t maxAge;
+    uint8_t i;
+    uint8_t slot = 0;
+#endif
+
+    if(pEntry->getFunc == NULL)
+        return;
+#if MB_FEATURE_GETCACHE
+    maxAge = MaxAge(idx);
+    if(maxAge != 0)
+    {
+        now = millis();
+        for(i=0;i<MAX_GET_CACHE;i++)
+        {
+            if(getCache[i].pEntry == pEntry)
+                break;
+            // Otherwise a stale entry or the one read longest ago is reused
+            if(getCache[slot].gen == getGen && (getCache[i].gen != getGen || now - getCache[i].time > now - getCache[slot].time))
+                slot = i;
+        }
+        if(i < MAX_GET_CACHE)
+        {
+            if(getCache[i].gen == getGen && (now - getCache[i].time) < maxAge)
+                return;
+            slot = i;
+        }
+        (*pEntry->getFunc)(pEntry->id);
+        getCache[slot].pEntry = pEntry;
+        getCache[slot].time = millis();
+        getCache[slot].gen = getGen;
+        return;
+    }
+#endif
+    (*pEntry->getFunc)(pEntry->id);
+}
+
+#if MB_FEATURE_SEQLOCK
+void microBoxEsp::SetSeqLock(const PARAM_SEQ *pTable)
+{
+    pSeqs = pTable;
+}
+
+// Sequence counter of a parameter from the SetSeqLock() table
+volatile uint8_t *microBoxEsp::SeqOf(uint16_t idx)
+{
+    const PARAM_SEQ *pEntry;
+
+    if(pSeqs == NULL)
+        return NULL;
+    for(pEntry=pSeqs;pEntry->pParam != NULL;pEntry++)
+    {
+        if(pEntry->pParam == Params[idx].pParam)
+            return pEntry->pSeq;
+    }
+    return NULL;
+}
+#endif
+
+// Copies an int or double. A PARTYPE_SEQLOCK value is read again until
+// *pSeq was even and unchanged around the copy, which only fails if the
+// writer keeps interrupting; the last try copies with interrupts off.
+void microBoxEsp::ReadParam(uint16_t idx, void *pDst, uint8_t size)
+{
+#if MB_FEATURE_SEQLOCK
+    volatile uint8_t *pSeq;
+    const volatile uint8_t *pSrc;
+    uint8_t *pOut;
+    uint8_t seq;
+    uint16_t tries;
+    uint8_t i;
+
+    pSeq = NULL;
+    if(Params[idx].parType & PARTYPE_SEQLOCK)
+        pSeq = SeqOf(idx);
+    if(pSeq != NULL)
+    {
+        for(tries=0;tries<MAX_SEQ_RETRIES;tries++)
+        {
+            seq = *pSeq;
+            if(seq & 1)
+                continue;
+            pSrc = (const volatile uint8_t*)Params[idx].pParam;
+            pOut = (uint8_t*)pDst;
+            for(i=0;i<size;i++)
+                *pOut++ = *pSrc++;
+            if(*pSeq == seq)
+                return;
+        }
+        noInterrupts();
+        memcpy(pDst, Params[idx].pParam, size);
+        interrupts();
+        return;
+    }
+#endif
+    memcpy(pDst, Params[idx].pParam, size);
+}
+
+void microBoxEsp::PrintParam(uint16_t idx, uint16_t first, uint16_t end)
+{
+    CallGetFunc(idx);
+    PrintValue(idx, first, end);
+}
+
+// Prints the value without calling getFunc, arrays print the
+// elements first to end-1 straight from the table
+void microBoxEsp::PrintValue(uint16_t idx, uint16_t first, uint16_t end)
+{
+    uint16_t i;
+    int iVal;
+    double fVal;
+
+    if(Params[idx].parType&PARTYPE_ARRAY)
+    {
+        if(end > Params[idx].len)
+            end = Params[idx].len;
+        pTransport->StartCoalesce();
+        for(i=first;i<end;i++)
+        {
+            if(i != first)
+                pTransport->print(F(" "));
+            if(Params[idx].parType&PARTYPE_INT)
+                pTransport->print(((int*)Params[idx].pParam)[i]);
+            else
+                pTransport->print(((double*)Params[idx].pParam)[i], 8);
+        }
+        pTransport->EndCoalesce();
+    }
+    else if(Params[idx].parType&PARTYPE_INT)
+    {
+        ReadParam(idx, &iVal, sizeof(iVal));
+        pTransport->print(iVal);
+    }
+    else if(Params[idx].parType&PARTYPE_DOUBLE)
+    {
+        ReadParam(idx, &fVal, sizeof(fVal));
+        pTransport->print(fVal, 8);
+    }
+    else
+        pTransport->print(((char*)Params[idx].pParam));
+
+#if MB_FEATURE_WATCH
+    if(csvMode)
+    {
+        pTransport->print(F(";"));
+    }
+    else
+#endif
+        pTransport->println();
+}
+
+// Resolves a parameter path. Arrays may be followed by [i] or [first:end],
+// which is only accepted if pFirst/pEnd are given to receive the range.
+int16_t microBoxEsp::GetParamIdx(char *pParam, uint16_t *pFirst, uint16_t *pEnd)
+{
+    int16_t node;
+    uint16_t idx;
+    uint16_t first, end;
+    char *pSub;
+
+    if(pParam == NULL)
+        return -1;
+
+    pSub = strchr(pParam, '[');
+    node = ResolvePath(curNode, pParam, pSub != NULL ? pSub - pParam : strlen(pParam));
+    if(node < 0 || !(Nodes[node].flags & NODE_PARAM))
+        return -1;
+    idx = Nodes[node].idx;
+
+    first = 0;
+    end = 0xffff;
+    if(pSub != NULL)
+    {
+        if(pFirst == NULL || !(Params[idx].parType & PARTYPE_ARRAY))
+            return -1;
+        first = strtoul(pSub+1, &pSub, 10);
+        end = first + 1;
+        if(*pSub == ':')
+        {
+            pSub++;
+            end = Params[idx].len;
+            if(*pSub != ']')
+                end = strtoul(pSub, &pSub, 10);
+            if(end > Params[idx].len)
+                end = Params[idx].len;
+        }
+        if(pSub[0] != ']' || pSub[1] != 0 || end > Params[idx].len || first >= end)
+            return -1;
+    }
+    if(pFirst != NULL)
+    {
+        *pFirst = first;
+        *pEnd = end;
+    }
+    return idx;
+}
+
+// Based on Stream.cpp. Digits are summed up as double, a long overflows
+// with the 8 fraction digits dump prints.
+double microBoxEsp::parseFloat(char *pBuf)
+{
+    boolean isNegative = false;
+    boolean isFraction = false;
+    double value = 0;
+    unsigned char c;
+    double fraction = 1.0;
+    uint8_t idx = 0;
+
+    c = pBuf[idx++];
+    // ignore non numeric leading characters
+    if(c > 127)
+        return 0; // zero returned if timeout
+
+    do{
+        if(c == '-')
+            isNegative = true;
+        else if (c == '.')
+            isFraction = true;
+        else if(c >= '0' && c <= '9')  {      // is c a digit?
+            if(isFraction)
+            {
+                fraction *= 0.1;
+                value += (c - '0') * fraction;
+            }
+            else
+                value = value * 10 + c - '0';
+        }
+        c = pBuf[idx++];
+    }
+    while( (c >= '0' && c <= '9')  || c == '.');
+
+    if(isNegative)
+        value = -value;
+    return value;
+}
+
+// Bytes of the value in RAM
+uint16_t microBoxEsp::ParamSize(uint16_t idx)
+{
+    uint16_t size;
+
+    if(Params[idx].parType&PARTYPE_INT)
+        size = sizeof(int);
+    else if(Params[idx].parType&PARTYPE_DOUBLE)
+        size = sizeof(double);
+    else
+        return Params[idx].len;
+    if(Params[idx].parType&PARTYPE_ARRAY)
+        size *= Params[idx].len;
+    return size;
+}
+
+// Arrays take one value per element separated by spaces, written
+// from element first on, at most up to end-1
+bool microBoxEsp::WriteParam(uint16_t idx, char *pVal, uint16_t first, uint16_t end)
+{
+    uint16_t i;
+
+    if(!(Params[idx].parType & PARTYPE_RW))
+        return false;
+
+    if(Params[idx].parType & PARTYPE_ARRAY)
+    {
+        if(end > Params[idx].len)
+            end = Params[idx].len;
+        for(i=first;i<end;i++)
+        {
+            while(*pVal == ' ')
+                pVal++;
+            if(*pVal == 0)
+                break;
+            if(Params[idx].parType & PARTYPE_INT)
+                ((int*)Params[idx].pParam)[i] = atoi(pVal);
+            else
+                ((double*)Params[idx].pParam)[i] = parseFloat(pVal);
+            while(*pVal != ' ' && *pVal != 0)
+                pVal++;
         }
+    }
+    else if(Params[idx].parType & PARTYPE_INT)
+    {
+        int val;
+
+        val = atoi(pVal);
+        *((int*)Params[idx].pParam) = val;
+    }
+    else if(Params[idx].parType & PARTYPE_DOUBLE)
+    {
+        double val;
+
+        val = parseFloat(pVal);
+        *((double*)Params[idx].pParam) = val;
+    }
+    else
+    {
+        if(strlen(pVal) >= Params[idx].len)
+            return false;
+        strcpy((char*)Params[idx].pParam, pVal);
+    }
+    return true;
+}
+
+// echo 82.00 > /dev/param
+// echo 5 > /dev/array[3], echo "1 2 3" > /dev/array[0:3]
+void microBoxEsp::Echo(char **pParam, uint8_t parCnt)
+{
+    int16_t idx;
+    uint16_t first, end;
+
+    if((parCnt == 3) && (strcmp_P(pParam[1], PSTR(">")) == 0))
+    {
+#if MB_FEATURE_PROFILER
+        // echo 1 > /proc/reset clears the profiler counters
+        idx = ResolvePath(curNode, pParam[2], strlen(pParam[2]));
+        if(idx >= 0 && (Nodes[idx].flags & NODE_PROC))
+        {
+            if(Nodes[idx].idx == PROC_RESET)
+                Reset();
+            else
+            {
+                cmdError = true;
+                pTransport->println(F("echo: File readonly"));
+            }
+            return;
+        }
+#endif
+        idx = GetParamIdx(pParam[2], &first, &end);
+        if(idx != -1)
+        {
+#if MB_FEATURE_TRANSACTION
+            if(txnActive)
+                StageParam(idx, pParam[0], first, end);
+            else
+#endif
+            if(WriteParam(idx, pParam[0], first, end))
+            {
+                if(Params[idx].setFunc != NULL)
+                    (*Params[idx].setFunc)(Params[idx].id);
+            }
+            else
+            {
+                cmdError = true;
+                if(Params[idx].parType & PARTYPE_RW)
+                    pTransport->println(F("echo: Value too long"));
+                else
+                    pTransport->println(F("echo: File readonly"));
+            }
+        }
+        else
+        {
+            ErrorDir(F("echo"));
+        }
+    }
+    else
+    {
+        for(idx=0;idx<parCnt;idx++)
+        {
+            pTransport->print(pParam[idx]);
+            pTransport->print(F(" "));
+        }
+        pTransport->println();
+    }
+}
+
+void microBoxEsp::Cat(char **pParam, uint8_t parCnt)
+{
+    Cat_int(pParam[0]);
+}
+
+// cat /dev/param, cat /dev/array[10:20]
+uint8_t microBoxEsp::Cat_int(char *pParam)
+{
+    int16_t idx;
+    uint16_t first, end;
+#if MB_FEATURE_TMPFS
+    const char *pName;
+    const uint8_t *pData;
+    uint16_t size;
+
+    if(pParam != NULL && (pName = TmpName(pParam)) != NULL)
+    {
+        if(TmpFs.Open(pName, &pData, &size))
+        {
+            pTransport->StartCoalesce();
+            pTransport->write(pData, size);
+            pTransport->EndCoalesce();
+            return 1;
+        }
+        ErrorDir(F("cat"));
+        return 0;
+    }
+#endif
+#if MB_FEATURE_PROFILER
+    int16_t node;
+
+    if(pParam != NULL)
+    {
+        node = ResolvePath(curNode, pParam, strlen(pParam));
+        if(node >= 0 && (Nodes[node].flags & NODE_PROC))
+        {
+            ShowProc(Nodes[node].idx);
+            return 1;
+        }
+    }
+#endif
+
+    idx = GetParamIdx(pParam, &first, &end);
+    if(idx != -1)
+    {
+        PrintParam(idx, first, end);
+        return 1;
+    }
+    else
+        ErrorDir(F("cat"));
+    
+    return 0;
+}
+
+#if MB_FEATURE_WATCH
+// watch [-d deadband] [-h heartbeat] [-w window] cat /dev/param
+// With -d or -h the value is only sent when it moved by more than
+// deadband since the last send, or when heartbeat seconds have passed.
+// With -w min, max, mean and stddev are sent once per window ms.
+void microBoxEsp::watch(char **pParam, uint8_t parCnt)
+{
+    uint8_t i=0;
+
+    watchOnChange = false;
+    watchWindow = 0;
+    watchDeadband = 0;
+    watchHeartbeat = WATCH_HEARTBEAT;
+    while(i+1 < parCnt && pParam[i][0] == '-')
+    {
+        if(strcmp_P(pParam[i], PSTR("-d")) == 0)
+            watchDeadband = fabs(parseFloat(pParam[i+1]));
+        else if(strcmp_P(pParam[i], PSTR("-h")) == 0)
+            watchHeartbeat = atoi(pParam[i+1]);
+        else if(strcmp_P(pParam[i], PSTR("-w")) == 0)
+            watchWindow = atol(pParam[i+1]);
+        else
+            return;
+        watchOnChange = true;
+        i += 2;
+    }
+
+    if(parCnt-i == 2)
+    {
+        if(strncmp_P(pParam[i], PSTR("cat"), 3) == 0)
+        {
+            if(Cat_int(pParam[i+1]))
+            {
+                // /proc files are always polled
+                watchIdx = GetParamIdx(pParam[i+1]);
+                if(watchIdx == -1)
+                    watchOnChange = false;
+                else
+                    watchLast = ParamValue(watchIdx);
+                if(!watchOnChange || (Params[watchIdx].parType & (PARTYPE_STRING|PARTYPE_ARRAY)))
+                    watchWindow = 0;
+                watchSent = millis();
+                watchWinStart = millis();
+                watchPace = watchOnChange ? WATCH_POLL_MS : WATCH_INTERVALL;
+                watchLatency = 0;
+                watchDrops = 0;
+                aggCnt = 0;
+                // The command is a token of cmdBuf itself
+                memmove(cmdBuf, pParam[i+1], strlen(pParam[i+1]) + 1);
+                watchMode = true;
+            }
+        }
+    }
+}
+
+// Welford's running mean and variance, no memory per sample
+void microBoxEsp::WatchAggregate()
+{
+    double val, delta;
+
+    if(isTimeout(&watchTimeout, WATCH_SAMPLE_MS))
+    {
+        CallGetFunc(watchIdx);
+        val = ParamValue(watchIdx);
+        if(aggCnt == 0 || val < aggMin)
+            aggMin = val;
+        if(aggCnt == 0 || val > aggMax)
+            aggMax = val;
+        if(aggCnt == 0)
+        {
+            aggMean = 0;
+            aggM2 = 0;
+        }
+        if(aggCnt < 0xffff)
+            aggCnt++;
+        delta = val - aggMean;
+        aggMean += delta / aggCnt;
+        aggM2 += delta * (val - aggMean);
+    }
+
+    if(aggCnt != 0 && (millis() - watchWinStart) >= watchWindow)
+    {
+        watchWinStart += watchWindow;
+        pTransport->StartCoalesce();
+        PrintAggregate(aggMin, false);
+        PrintAggregate(aggMax, false);
+        PrintAggregate(aggMean, false);
+        PrintAggregate(aggCnt > 1 ? sqrt(aggM2 / (aggCnt-1)) : 0, true);
+        pTransport->EndCoalesce();
+        aggCnt = 0;
+    }
+}
+
+void microBoxEsp::PrintAggregate(double val, bool last)
+{
+    pTransport->print(val, 4);
+    if(csvMode)
+        pTransport->print(F(";"));
+    else if(last)
+        pTransport->println();
+    else
+        pTransport->print(F("\t"));
+}
+
+// Value for the deadband check, strings and arrays compare by checksum
+double microBoxEsp::ParamValue(uint16_t idx)
+{
+    uint16_t sum = 0;
+    uint16_t len;
+    char *p;
+    int iVal;
+    double fVal;
+
+    if(Params[idx].parType&PARTYPE_ARRAY)
+    {
+        len = Params[idx].len * ((Params[idx].parType&PARTYPE_INT) ? sizeof(int) : sizeof(double));
+        for(p=(char*)Params[idx].pParam;len>0;len--,p++)
+            sum = (sum << 1 | sum >> 15) + *p;
+        return sum;
+    }
+    else if(Params[idx].parType&PARTYPE_INT)
+    {
+        ReadParam(idx, &iVal, sizeof(iVal));
+        return iVal;
+    }
+    else if(Params[idx].parType&PARTYPE_DOUBLE)
+    {
+        ReadParam(idx, &fVal, sizeof(fVal));
+        return fVal;
+    }
+
+    for(p=(char*)Params[idx].pParam;*p!=0;p++)
+        sum = (sum << 1 | sum >> 15) + *p;
+    return sum;
+}
+
+void microBoxEsp::WatchChanges()
+{
+    double val;
+
+    if(!isTimeout(&watchTimeout, WATCH_POLL_MS))
+        return;
 
-        PasswordPrompt();
-    }
-    else
+    CallGetFunc(watchIdx);
+    val = ParamValue(watchIdx);
+    if(fabs(val - watchLast) > watchDeadband ||
+       (watchHeartbeat != 0 && (millis() - watchSent) >= watchHeartbeat * 1000UL))
     {
-        if(loginState < STATE_LOGIN_LOGGEDIN && strcmp(cmdBuf, password) == 0)
-        {
-            loginState = STATE_LOGIN_LOGGEDIN;
-            esp8266.println();
-            ShowPrompt();
-        }
-        else
-        {
-            loginState++;
-            if(loginState != STATE_LOGIN_LOGGEDIN && loginState < STATE_LOGIN_USER_ERROR)
-                PasswordPrompt();
-            else
-                Exit();
-        }
+        // A slow link defers the change, the next send has the latest value
+        if((millis() - watchSent) < watchPace)
+            return;
+        WatchSend();
+        watchLast = val;
     }
 }
 
-bool microBoxEsp::HandleEscSeq(unsigned char ch)
+// Sends one sample and adapts watchPace to the time the transport
+// blocked for it, e.g. waiting for SEND OK from the esp8266. The pace
+// doubles while sending takes more than half of it and goes back
+// towards the requested rate once sending takes less than a quarter.
+void microBoxEsp::WatchSend()
 {
-    bool ret = false;
+    unsigned long start = millis();
+    uint16_t rate = watchOnChange ? WATCH_POLL_MS : WATCH_INTERVALL;
+    uint16_t pace = watchPace;
 
-    if(ch == 27)
+    // Samples the requested rate would have sent meanwhile are skipped
+    if(!watchOnChange && (start - watchSent) >= 2UL * rate)
+        watchDrops += (start - watchSent) / rate - 1;
+
+    pTransport->StartCoalesce();
+    if(watchOnChange)
+        PrintValue(watchIdx);
+    else
+        Cat_int(cmdBuf);
+    pTransport->EndCoalesce();
+
+    watchLatency = (3UL * watchLatency + (millis() - start)) / 4;
+    if(2UL * watchLatency > watchPace && watchPace < WATCH_PACE_MAX)
+        watchPace = (2UL * watchPace > WATCH_PACE_MAX) ? WATCH_PACE_MAX : 2 * watchPace;
+    else if(4UL * watchLatency < watchPace && watchPace > rate)
+        watchPace = (watchPace / 2 < rate) ? rate : watchPace / 2;
+
+    if(watchPace != pace && !csvMode)
     {
-        escSeq = ESC_STATE_START;
-        ret = true;
+        pTransport->StartCoalesce();
+        pTransport->print(F("watch: interval "));
+        pTransport->print((int)watchPace);
+        pTransport->print(F(" ms, "));
+        pTransport->print((int)watchDrops);
+        pTransport->println(F(" dropped"));
+        pTransport->EndCoalesce();
     }
-    else if(escSeq == ESC_STATE_START)
+    watchSent = start;
+}
+#endif
+
+#if MB_FEATURE_SCRIPTS
+// sh script
+void microBoxEsp::Shell(char **pParam, uint8_t parCnt)
+{
+    int8_t idx;
+
+    if(parCnt == 1 && (idx = GetScriptIdx(pParam[0])) != -1)
     {
-        if(ch == 0x5B)
+        if(scriptDepth < MAX_SCRIPT_DEPTH)
         {
-            escSeq = ESC_STATE_CODE;
-            ret = true;
+            if(!RunScript(idx))
+                cmdError = true;
         }
         else
-            escSeq = ESC_STATE_NONE;
-    }
-    else if(escSeq == ESC_STATE_CODE)
-    {
-        if(ch == 0x41) // Cursor Up
-        {
-            HistoryUp();
-        }
-        else if(ch == 0x42) // Cursor Down
-        {
-            HistoryDown();
-        }
-        else if(ch == 0x43) // Cursor Right
         {
+            cmdError = true;
+            pTransport->println(F("sh: Script nesting too deep"));
         }
-        else if(ch == 0x44) // Cursor Left
+    }
+    else
+        ErrorDir(F("sh"));
+}
+#endif
+
+#if MB_FEATURE_WATCH
+void microBoxEsp::watchcsv(char **pParam, uint8_t parCnt)
+{
+    watch(pParam, parCnt);
+    if(watchMode)
+        csvMode = true;
+}
+#endif
+
+#if MB_FEATURE_DUMPLOAD
+// Parameter by its name in the table, like dump prints it, or by absolute path
+int16_t microBoxEsp::FindParam(char *pName)
+{
+    int16_t node;
+
+    node = ResolvePath(NODE_DEV, pName, strlen(pName));
+    if(node >= 0 && (Nodes[node].flags & NODE_PARAM))
+        return Nodes[node].idx;
+    return -1;
+}
+
+void microBoxEsp::EndLoad()
+{
+    loadMode = false;
+    CommitSetFuncs();
+    pTransport->StartCoalesce();
+    pTransport->print(F("load: "));
+    pTransport->print(loadCnt);
+    pTransport->print(F(" set, "));
+    pTransport->print(loadErrors);
+    pTransport->println(F(" errors"));
+    ShowPrompt();
+    pTransport->EndCoalesce();
+}
+
+// Applies one "name=value" line
+bool microBoxEsp::LoadLine(char *pLine)
+{
+    char *pVal;
+    int16_t idx;
+
+    if(*pLine == 0)
+        return true;
+
+    pVal = strchr(pLine, '=');
+    if(pVal != NULL)
+    {
+        *pVal++ = 0;
+        idx = FindParam(pLine);
+        if(idx != -1 && WriteParam(idx, pVal))
         {
+            QueueSetFunc(idx);
+            loadCnt++;
+            return true;
         }
-        escSeq = ESC_STATE_NONE;
-        blockRead = 0;
-        ret = true;
     }
-    return ret;
+    loadErrors++;
+    return false;
 }
 
+// dump
+#endif
 
-uint8_t microBoxEsp::ParCmp(uint8_t idx1, uint8_t idx2, bool cmd)
+#if MB_FEATURE_DUMPLOAD || MB_FEATURE_TRANSACTION
+// Remembers the setFunc of a written parameter, each setFunc/id pair
+// is called only once by CommitSetFuncs().
+void microBoxEsp::QueueSetFunc(uint16_t idx)
 {
-    uint8_t i=0;
+    uint8_t i;
 
-    const char *pName1;
-    const char *pName2;
+    if(Params[idx].setFunc == NULL)
+        return;
 
-    if(cmd)
+    for(i=0;i<pendingCnt;i++)
     {
-        pName1 = Cmds[idx1].cmdName;
-        pName2 = Cmds[idx2].cmdName;
+        if(Params[pendingSet[i]].setFunc == Params[idx].setFunc && Params[pendingSet[i]].id == Params[idx].id)
+            return;
     }
+    if(pendingCnt < MAX_PENDING_SET)
+        pendingSet[pendingCnt++] = idx;
     else
+        (*Params[idx].setFunc)(Params[idx].id);
+}
+
+void microBoxEsp::CommitSetFuncs()
+{
+    uint8_t i;
+
+    for(i=0;i<pendingCnt;i++)
+        (*Params[pendingSet[i]].setFunc)(Params[pendingSet[i]].id);
+    pendingCnt = 0;
+}
+#endif
+
+#if MB_FEATURE_TRANSACTION
+// Staging memory for begin/commit, the memory stays with the caller.
+// Each written parameter takes 2 bytes plus its size.
+void microBoxEsp::SetTransactionBuffer(uint8_t *pBuf, uint16_t size)
+{
+    txnActive = false;
+    txnBuf = pBuf;
+    txnSize = size;
+    txnLen = 0;
+}
+
+uint8_t *microBoxEsp::FindStaged(uint16_t idx)
+{
+    uint16_t pos = 0;
+    uint16_t entryIdx;
+
+    while(pos < txnLen)
     {
-        pName1 = Params[idx1].paramName;
-        pName2 = Params[idx2].paramName;
+        memcpy(&entryIdx, txnBuf + pos, sizeof(entryIdx));
+        pos += sizeof(entryIdx);
+        if(entryIdx == idx)
+            return txnBuf + pos;
+        pos += ParamSize(entryIdx);
     }
+    return NULL;
+}
+
+void microBoxEsp::SwapStaged(uint16_t idx, uint8_t *pStaged)
+{
+    uint8_t *pParam = (uint8_t*)Params[idx].pParam;
+    uint16_t size = ParamSize(idx);
+    uint8_t ch;
 
-    while(pName1[i] != 0 && pName2[i] != 0)
+    while(size--)
     {
-        if(pName1[i] != pName2[i])
-            return i;
-        i++;
+        ch = *pParam;
+        *pParam++ = *pStaged;
+        *pStaged++ = ch;
     }
-    return i;
 }
 
-int8_t microBoxEsp::GetCmdIdx(char* pCmd, int8_t startIdx)
+// The value is written by WriteParam() while the staged copy is
+// swapped into the parameter, so slices of arrays work as usual
+// and the application only ever sees committed values.
+void microBoxEsp::StageParam(uint16_t idx, char *pVal, uint16_t first, uint16_t end)
 {
-    while(Cmds[startIdx].cmdName != NULL)
+    uint8_t *pStaged;
+    uint16_t size = ParamSize(idx);
+    bool ok;
+
+    if(!(Params[idx].parType & PARTYPE_RW))
+    {
+        cmdError = true;
+        pTransport->println(F("echo: File readonly"));
+        return;
+    }
+    pStaged = FindStaged(idx);
+    if(pStaged == NULL)
     {
-        if(strncmp(Cmds[startIdx].cmdName, pCmd, strlen(pCmd)) == 0)
+        if(txnLen + sizeof(idx) + size > txnSize)
         {
-            return startIdx;
+            cmdError = true;
+            pTransport->println(F("echo: Transaction buffer full"));
+            return;
         }
-        startIdx++;
+        memcpy(txnBuf + txnLen, &idx, sizeof(idx));
+        pStaged = txnBuf + txnLen + sizeof(idx);
+        memcpy(pStaged, Params[idx].pParam, size);
+        txnLen += sizeof(idx) + size;
+    }
+    SwapStaged(idx, pStaged);
+    ok = WriteParam(idx, pVal, first, end);
+    SwapStaged(idx, pStaged);
+    if(!ok)
+    {
+        cmdError = true;
+        pTransport->println(F("echo: Value too long"));
     }
-    return -1;
 }
 
-void microBoxEsp::HandleTab()
+void microBoxEsp::Begin(char **pParam, uint8_t parCnt)
 {
-    int8_t idx, idx2;
-    char *pParam = NULL;
-    uint8_t i, len = 0;
-    uint8_t parlen, matchlen, inlen;
+    if(txnBuf == NULL)
+    {
+        cmdError = true;
+        pTransport->println(F("begin: No transaction buffer"));
+    }
+    else if(txnActive)
+    {
+        cmdError = true;
+        pTransport->println(F("begin: Transaction active"));
+    }
+    else
+    {
+        txnActive = true;
+        txnLen = 0;
+    }
+}
 
-    for(i=0;i<bufPos;i++)
+// All values are copied before the first setFunc runs, every
+// setFunc/id pair is called once
+void microBoxEsp::Commit(char **pParam, uint8_t parCnt)
+{
+    uint16_t pos = 0;
+    uint16_t idx;
+    uint16_t size;
+
+    if(!txnActive)
     {
-        if(cmdBuf[i] == ' ')
-            pParam = cmdBuf+i;
+        cmdError = true;
+        pTransport->println(F("commit: No transaction"));
+        return;
     }
-    if(pParam != NULL)
+    while(pos < txnLen)
     {
-        pParam++;
-        if(*pParam != 0)
-        {
-            idx = GetParamIdx(pParam, true, 0);
-            if(idx >= 0)
-            {
-                parlen = strlen(Params[idx].paramName);
-                matchlen = parlen;
-                idx2=idx;
-                while((idx2=GetParamIdx(pParam, true, idx2+1))!= -1)
-                {
-                    matchlen = ParCmp(idx, idx2);
-                    if(matchlen < parlen)
-                        parlen = matchlen;
-                }
-                pParam = GetFile(pParam);
-                inlen = strlen(pParam);
-                if(matchlen > inlen)
-                {
-                    len = matchlen - inlen;
-                    if((bufPos + len) < MAX_CMD_BUF_SIZE)
-                    {
-                        strncat(cmdBuf, Params[idx].paramName + inlen, len);
-                        bufPos += len;
-                    }
-                    else
-                        len = 0;
-                }
-            }
-        }
+        memcpy(&idx, txnBuf + pos, sizeof(idx));
+        pos += sizeof(idx);
+        size = ParamSize(idx);
+        memcpy(Params[idx].pParam, txnBuf + pos, size);
+        pos += size;
     }
-    else if(bufPos)
+    pendingCnt = 0;
+    pos = 0;
+    while(pos < txnLen)
     {
-        pParam = cmdBuf;
+        memcpy(&idx, txnBuf + pos, sizeof(idx));
+        QueueSetFunc(idx);
+        pos += sizeof(idx) + ParamSize(idx);
+    }
+    txnActive = false;
+    txnLen = 0;
+    CommitSetFuncs();
+}
 
-        idx = GetCmdIdx(pParam);
-        if(idx >= 0)
-        {
-            parlen = strlen(Cmds[idx].cmdName);
-            matchlen = parlen;
-            idx2=idx;
-            while((idx2=GetCmdIdx(pParam, idx2+1))!= -1)
-            {
-                matchlen = ParCmp(idx, idx2, true);
-                if(matchlen < parlen)
-                    parlen = matchlen;
-            }
-            inlen = strlen(pParam);
-            if(matchlen > inlen)
-            {
-                len = matchlen - inlen;
-                if((bufPos + len) < MAX_CMD_BUF_SIZE)
-                {
-                    strncat(cmdBuf, Cmds[idx].cmdName + inlen, len);
-                    bufPos += len;
-                }
-                else
-                    len = 0;
-            }
-        }
+void microBoxEsp::Abort(char **pParam, uint8_t parCnt)
+{
+    if(!txnActive)
+    {
+        cmdError = true;
+        pTransport->println(F("abort: No transaction"));
+        return;
     }
-    if(len > 0)
+    txnActive = false;
+    txnLen = 0;
+}
+#endif
+
+#if MB_FEATURE_RECORDER
+// Ring buffer for the rec command, the memory stays with the caller
+void microBoxEsp::SetRecordBuffer(uint8_t *pBuf, uint16_t size)
+{
+    recActive = false;
+    recBuf = pBuf;
+    recSize = size;
+    recCnt = 0;
+    recTotal = 0;
+    recSkipped = 0;
+}
+
+// rec start ms param [param..] | stop | status | dump
+void microBoxEsp::Record(char **pParam, uint8_t parCnt)
+{
+    if(parCnt >= 3 && strcmp_P(pParam[0], PSTR("start")) == 0)
+        RecordStart(pParam+1, parCnt-1);
+    else if(parCnt == 1 && strcmp_P(pParam[0], PSTR("stop")) == 0)
+        recActive = false;
+    else if(parCnt == 1 && strcmp_P(pParam[0], PSTR("status")) == 0)
+        RecordStatus();
+    else if(parCnt == 1 && strcmp_P(pParam[0], PSTR("dump")) == 0)
+        RecordDump();
+    else
     {
-        esp8266.print(pParam + inlen);
+        cmdError = true;
+        pTransport->println(F("usage: rec start ms param.. | stop | status | dump"));
     }
 }
 
-void microBoxEsp::HistoryUp()
+void microBoxEsp::RecordStart(char **pParam, uint8_t parCnt)
 {
-    if(historyBufSize == 0 || historyWrPos == 0)
+    uint8_t i;
+    int16_t idx;
+    uint8_t rowLen = sizeof(uint16_t);     // Slot number, see RecordSample()
+
+    recActive = false;
+    if(parCnt-1 > MAX_REC_PARAMS)
+    {
+        cmdError = true;
+        pTransport->println(F("rec: Too many parameters"));
+        return;
+    }
+    for(i=1;i<parCnt;i++)
+    {
+        idx = GetParamIdx(pParam[i]);
+        if(idx == -1 || !(Params[idx].parType & (PARTYPE_INT|PARTYPE_DOUBLE)) || (Params[idx].parType & PARTYPE_ARRAY))
+        {
+            ErrorDir(F("rec"));
+            return;
+        }
+        recIdx[i-1] = idx;
+        // Fixed width samples, int is 16 bit on AVR
+        rowLen += (Params[idx].parType & PARTYPE_INT) ? sizeof(int16_t) : sizeof(float);
+    }
+    if(recBuf == NULL || rowLen > recSize)
+    {
+        cmdError = true;
+        pTransport->println(F("rec: No buffer"));
         return;
+    }
 
-    if(historyCursorPos == -1)
-        historyCursorPos = historyWrPos-2;
+    recParCnt = parCnt-1;
+    recRowLen = rowLen;
+    recRows = recSize / rowLen;
+    recIntervall = atoi(pParam[0]);
+    if(recIntervall == 0)
+        recIntervall = 1;
+    recHead = 0;
+    recCnt = 0;
+    recTotal = 0;
+    recSlot = 0;
+    recSkipped = 0;
+    recNext = millis();
+    recActive = true;
+}
 
-    while(historyBuf[historyCursorPos] != 0 && historyCursorPos > 0)
+void microBoxEsp::RecordSample()
+{
+    uint8_t *pRow;
+    uint8_t i;
+    uint16_t idx;
+    int16_t iVal;
+    float fVal;
+    int intVal;
+    double dblVal;
+    unsigned long late;
+    uint16_t slot;
+
+    late = millis() - recNext;
+    if((long)late < 0)
+        return;
+    // Fixed rate, late samples do not shift the following ones. Slots
+    // missed while the loop was blocked are skipped, not filled with
+    // the current value. Each row keeps its slot for the dump.
+    late /= recIntervall;
+    recSlot += late;
+    recSkipped += late;
+    recNext += (late + 1) * recIntervall;
+
+    pRow = recBuf + recHead * recRowLen;
+    slot = recSlot++;
+    memcpy(pRow, &slot, sizeof(slot));
+    pRow += sizeof(slot);
+    for(i=0;i<recParCnt;i++)
     {
-        historyCursorPos--;
+        idx = recIdx[i];
+        CallGetFunc(idx);
+        if(Params[idx].parType & PARTYPE_INT)
+        {
+            ReadParam(idx, &intVal, sizeof(intVal));
+            iVal = intVal;
+            memcpy(pRow, &iVal, sizeof(iVal));
+            pRow += sizeof(iVal);
+        }
+        else
+        {
+            ReadParam(idx, &dblVal, sizeof(dblVal));
+            fVal = dblVal;
+            memcpy(pRow, &fVal, sizeof(fVal));
+            pRow += sizeof(fVal);
+        }
     }
-    if(historyCursorPos > 0)
-        historyCursorPos++;
 
-    strcpy(cmdBuf, historyBuf+historyCursorPos);
-    HistoryPrintHlpr();
-    if(historyCursorPos > 1)
-        historyCursorPos -= 2;
+    recHead++;
+    if(recHead >= recRows)
+        recHead = 0;
+    if(recCnt < recRows)
+        recCnt++;
+    recTotal++;
 }
 
-void microBoxEsp::HistoryDown()
+void microBoxEsp::RecordStatus()
 {
-    int pos;
-    if(historyCursorPos != -1 && historyCursorPos != historyWrPos-2)
+    pTransport->StartCoalesce();
+    pTransport->print(F("state\t"));
+    if(recActive)
+        pTransport->println(F("recording"));
+    else
+        pTransport->println(F("stopped"));
+    PrintStat(F("intervall_ms"), recParCnt ? recIntervall : 0);
+    PrintStat(F("samples"), recCnt);
+    PrintStat(F("capacity"), recParCnt ? recRows : 0);
+    PrintStat(F("overwritten"), recTotal - recCnt);
+    PrintStat(F("skipped"), recSkipped);
+    pTransport->EndCoalesce();
+}
+
+// All samples in the ring as csv, oldest first. The first column is
+// the time in ms since rec start. Rows store the low 16 bits of their
+// slot, the ring must not span more than 65535 slots.
+void microBoxEsp::RecordDump()
+{
+    uint16_t row, pos;
+    uint16_t slot;
+    uint8_t i;
+    uint8_t *pRow;
+    int16_t iVal;
+    float fVal;
+    char buf[12];
+
+    pTransport->StartCoalesce();
+    pTransport->print(F("ms"));
+    for(i=0;i<recParCnt;i++)
     {
-        pos = historyCursorPos+2;
-        pos += strlen(historyBuf+pos) + 1;
+        pTransport->print(F(";"));
+        pTransport->print(Params[recIdx[i]].paramName);
+    }
+    pTransport->println();
 
-        strcpy(cmdBuf, historyBuf+pos);
-        HistoryPrintHlpr();
-        historyCursorPos = pos - 2;
+    pos = recCnt < recRows ? 0 : recHead;
+    for(row=0;row<recCnt;row++)
+    {
+        pRow = recBuf + pos * recRowLen;
+        memcpy(&slot, pRow, sizeof(slot));
+        pRow += sizeof(slot);
+        ultoa((recSlot - (uint16_t)((uint16_t)recSlot - slot)) * recIntervall, buf, 10);
+        pTransport->print(buf);
+        for(i=0;i<recParCnt;i++)
+        {
+            pTransport->print(F(";"));
+            if(Params[recIdx[i]].parType & PARTYPE_INT)
+            {
+                memcpy(&iVal, pRow, sizeof(iVal));
+                pTransport->print((int)iVal);
+                pRow += sizeof(iVal);
+            }
+            else
+            {
+                memcpy(&fVal, pRow, sizeof(fVal));
+                pTransport->print((double)fVal, 4);
+                pRow += sizeof(fVal);
+            }
+        }
+        pTransport->println();
+        pos++;
+        if(pos >= recRows)
+            pos = 0;
     }
+    pTransport->EndCoalesce();
 }
+#endif
 
-void microBoxEsp::HistoryPrintHlpr()
+#if MB_FEATURE_BINARY
+// CRC-16/CCITT, polynomial 0x1021, start value 0xffff
+static uint16_t Crc16(uint16_t crc, uint8_t data)
 {
     uint8_t i;
-    uint8_t len;
 
-    len = strlen(cmdBuf);
+    crc ^= (uint16_t)data << 8;
+    for(i=0;i<8;i++)
+        crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+    return crc;
+}
 
-    i = len + bufPos;
-    if(len<bufPos)
-        i += 3;
-    if(i>0)
+// bin put|get /dev/param|eeprom [offset]
+// Prints "bin: size offset chunk" and switches the connection to
+// binary frames until the transfer ends. Every frame is
+// SOH type seq len payload crc16, the CRC covers type to payload.
+// Each data frame is acknowledged with the next expected offset,
+// a transfer is resumed by starting it again at that offset.
+void microBoxEsp::Binary(char **pParam, uint8_t parCnt)
+{
+    int16_t idx;
+    bool put;
+    uint16_t offset = 0;
+
+    if(parCnt < 2 || parCnt > 3 ||
+       (strcmp_P(pParam[0], PSTR("put")) != 0 && strcmp_P(pParam[0], PSTR("get")) != 0))
+    {
+        cmdError = true;
+        pTransport->println(F("bin: Usage put|get path [offset]"));
+        return;
+    }
+    put = (pParam[0][0] == 'p');
+
+#if MB_FEATURE_EEPROM
+    if(strcmp_P(pParam[1], PSTR("eeprom")) == 0)
+    {
+        binPtr = NULL;
+        binIdx = -1;
+        binSize = E2END + 1;
+    }
+    else
+#endif
     {
-        esp8266.SendHeader(i);
-        for(i=0;i<bufPos;i++)
-            pSerial->print(F("\b"));
-        pSerial->print(cmdBuf);
-        if(len<bufPos)
+        idx = GetParamIdx(pParam[1]);
+        if(idx == -1)
+        {
+            ErrorDir(F("bin"));
+            return;
+        }
+        if(put && !(Params[idx].parType & PARTYPE_RW))
         {
-            pSerial->print(F("\x1B[K"));
+            cmdError = true;
+            pTransport->println(F("bin: File readonly"));
+            return;
         }
-        esp8266.WaitForSendComplete();
+        if(!put)
+            CallGetFunc(idx);
+        binPtr = (uint8_t*)Params[idx].pParam;
+        binIdx = idx;
+        binSize = ParamSize(idx);
     }
-    bufPos = len;
+
+    if(parCnt == 3)
+        offset = atol(pParam[2]);
+    if(offset > binSize)
+    {
+        cmdError = true;
+        pTransport->println(F("bin: Offset beyond end"));
+        return;
+    }
+
+    // Received data is checked in cmdBuf before it is written
+    binChunk = BIN_CHUNK;
+    if(put && binChunk > cmdBufSize)
+        binChunk = cmdBufSize;
+
+    pTransport->print(F("bin: "));
+    pTransport->print((int)binSize);
+    pTransport->print(F(" "));
+    pTransport->print((int)offset);
+    pTransport->print(F(" "));
+    pTransport->print(binChunk);
+    pTransport->println();
+
+    binMode = put ? BIN_PUT : BIN_GET;
+    binRxState = BIN_RX_SOH;
+    binOffset = offset;
+    binTxSeq = 0;
+    binRetries = 0;
+    binTimeout = millis();
+    if(!put)
+        BinSendNext();
 }
 
-void microBoxEsp::AddToHistory(char *buf)
+void microBoxEsp::BinPoll()
 {
-    uint8_t len;
-    int blockStart = 0;
+    if(binMode == BIN_PUT)
+    {
+        if((millis() - binTimeout) >= BIN_TIMEOUT)
+            BinEnd(F("Timeout"));
+    }
+    else if(isTimeout(&binTimeout, BIN_RETRY_MS))
+    {
+        if(++binRetries > BIN_RETRIES)
+            BinEnd(F("Timeout"));
+        else
+            BinSendNext();
+    }
+}
 
-    len = strlen(buf);
-    if(historyBufSize > 0)
+void microBoxEsp::BinInput(uint8_t ch)
+{
+    switch(binRxState)
     {
-        if(historyWrPos+len+1 >= historyBufSize)
+    case BIN_RX_SOH:
+        if(ch == BIN_SOH)
         {
-            while(historyWrPos+len-blockStart >= historyBufSize)
-            {
-                blockStart += strlen(historyBuf + blockStart) + 1;
-            }
-            memmove(historyBuf, historyBuf+blockStart, historyWrPos-blockStart);
-            historyWrPos -= blockStart;
-        }
-        strcpy(historyBuf+historyWrPos, buf);
-        historyWrPos += len+1;
-        historyBuf[historyWrPos] = 0;
+            binCrc = 0xffff;
+            binRxState = BIN_RX_TYPE;
+        }
+        return;
+    case BIN_RX_TYPE:
+        binType = ch;
+        binRxState = BIN_RX_SEQ;
+        break;
+    case BIN_RX_SEQ:
+        binSeq = ch;
+        binRxState = BIN_RX_LEN;
+        break;
+    case BIN_RX_LEN:
+        binLen = ch;
+        binPos = 0;
+        binRxState = ch ? BIN_RX_DATA : BIN_RX_CRC1;
+        if(ch > binChunk || ch > cmdBufSize)
+            binRxState = BIN_RX_SOH;
+        break;
+    case BIN_RX_DATA:
+        cmdBuf[binPos++] = ch;
+        if(binPos == binLen)
+            binRxState = BIN_RX_CRC1;
+        break;
+    case BIN_RX_CRC1:
+        binRxCrc = (uint16_t)ch << 8;
+        binRxState = BIN_RX_CRC2;
+        return;
+    case BIN_RX_CRC2:
+        binRxState = BIN_RX_SOH;
+        if((binRxCrc | ch) == binCrc)
+            BinFrame();
+        else if(binMode == BIN_PUT)
+            BinSendFrame(BIN_NAK, binTxSeq, 2);
+        return;
     }
+    binCrc = Crc16(binCrc, ch);
 }
 
-void microBoxEsp::ErrorDir(const __FlashStringHelper *cmd)
+void microBoxEsp::BinFrame()
 {
-    esp8266.print(cmd);
-    esp8266.println(F(": File or directory not found\n"));
-}
+    uint16_t offset = 0;
 
-char *microBoxEsp::GetDir(char *pParam, bool useFile)
-{
-    uint8_t i=0;
-    uint8_t len;
-    char *tmp;
+    if(binType == BIN_CANCEL)
+    {
+        BinEnd(F("Cancelled"));
+        return;
+    }
 
-    dirBuf[0] = 0;
-    if(pParam != NULL)
+    if(binMode == BIN_PUT)
     {
-        if(currentDir[1] != 0)
+        binTimeout = millis();
+        if(binType == BIN_DATA && binSeq == binTxSeq && binOffset + binLen <= binSize)
         {
-            if(pParam[0] != '/')
-            {
-                if(!(pParam[0] == '.' && pParam[1] == '.'))
-                {
-                    return NULL;
-                }
-                else
-                {
-                    pParam += 2;
-                    if(pParam[0] == 0)
-                    {
-                        dirBuf[0] = '/';
-                        dirBuf[1] = 0;
-                    }
-                    else if(pParam[0] != '/')
-                        return NULL;
-                }
-            }
+            if(binPtr != NULL)
+                memcpy(binPtr + binOffset, cmdBuf, binLen);
+#if MB_FEATURE_EEPROM
+            else
+                eeprom_write_block(cmdBuf, (void*)(uintptr_t)binOffset, binLen);
+#endif
+            binOffset += binLen;
+            binTxSeq++;
+            BinSendFrame(BIN_ACK, binSeq, 2);
         }
-        if(pParam[0] == '/')
+        else if(binType == BIN_DATA && binSeq == (uint8_t)(binTxSeq-1))
+            BinSendFrame(BIN_ACK, binSeq, 2);   // Our ACK got lost
+        else if(binType == BIN_END)
         {
-            if(pParam[1] == 0)
+            BinSendFrame(BIN_ACK, binSeq, 2);
+            if(binIdx != -1)
             {
-                dirBuf[0] = '/';
-                dirBuf[1] = 0;
+                // A shorter string must not keep the tail of the old one
+                if(Params[binIdx].parType & PARTYPE_STRING)
+                {
+                    if(binOffset < binSize)
+                        memset(binPtr + binOffset, 0, binSize - binOffset);
+                    binPtr[binSize-1] = 0;
+                }
+                if(Params[binIdx].setFunc != NULL)
+                    (*Params[binIdx].setFunc)(Params[binIdx].id);
             }
-            pParam++;
-        }
-
-        if((tmp=strchr(pParam, '/')) != 0)
-        {
-            len = tmp-pParam;
+            BinEnd(NULL);
         }
         else
-            len = strlen(pParam);
-        if(len > 0)
+            BinSendFrame(BIN_NAK, binTxSeq, 2);
+        return;
+    }
+
+    if(binLen == 2)
+        offset = (uint16_t)(uint8_t)cmdBuf[0] << 8 | (uint8_t)cmdBuf[1];
+    if(binLen != 2 || offset > binSize)
+        return;
+    if(binType == BIN_ACK)
+    {
+        if(binSeq != binTxSeq)
+            return;     // Duplicate of an earlier ACK
+        if(binOffset == binSize)
         {
-            while(pgm_read_byte_near(&dirList[i][0]) != 0)
-            {
-                if(strncmp_P(pParam, dirList[i], len) == 0)
-                {
-                    if(strlen_P(dirList[i]) == len)
-                    {
-                        dirBuf[0] = '/';
-                        dirBuf[1] = 0;
-                        strcat_P(dirBuf, dirList[i]);
-                        return dirBuf;
-                    }
-                }
-                i++;
-            }
+            BinEnd(NULL);
+            return;
         }
+        binTxSeq++;
     }
-    if(dirBuf[0] != 0)
-        return dirBuf;
-    return NULL;
+    else if(binType != BIN_NAK)
+        return;
+    binOffset = offset;
+    binRetries = 0;
+    BinSendNext();
 }
 
-char *microBoxEsp::GetFile(char *pParam)
+// get: sends the frame at binOffset, the END frame after the last one
+void microBoxEsp::BinSendNext()
 {
-    char *file;
-    char *t;
+    uint16_t len = binSize - binOffset;
 
-    file = pParam;
-    while((t=strchr(file, '/')) != NULL)
+    binTimeout = millis();
+    if(len == 0)
+        BinSendFrame(BIN_END, binTxSeq, 2);
+    else
+        BinSendFrame(BIN_DATA, binTxSeq, len > binChunk ? binChunk : len);
+}
+
+// DATA frames carry len bytes of the target at binOffset,
+// all others binOffset in 2 bytes, high byte first
+void microBoxEsp::BinSendFrame(uint8_t type, uint8_t seq, uint8_t len)
+{
+    uint16_t crc = 0xffff;
+    uint8_t i;
+    uint8_t ch;
+
+    pTransport->StartCoalesce();
+    BinSendByte(BIN_SOH, NULL);
+    BinSendByte(type, &crc);
+    BinSendByte(seq, &crc);
+    BinSendByte(len, &crc);
+    for(i=0;i<len;i++)
     {
-        file = t+1;
+        if(type != BIN_DATA)
+            ch = i ? binOffset & 0xff : binOffset >> 8;
+#if MB_FEATURE_EEPROM
+        else if(binPtr == NULL)
+            ch = eeprom_read_byte((uint8_t*)(uintptr_t)(binOffset + i));
+#endif
+        else
+            ch = binPtr[binOffset + i];
+        BinSendByte(ch, &crc);
     }
-    return file;
+    BinSendByte(crc >> 8, NULL);
+    BinSendByte(crc & 0xff, NULL);
+    pTransport->EndCoalesce();
 }
 
-void microBoxEsp::ListDirHlp(bool dir, const char *name, bool listLong, bool rw, uint16_t len)
+// Telnet needs 0xff doubled, it would start a command otherwise
+void microBoxEsp::BinSendByte(uint8_t ch, uint16_t *pCrc)
 {
-    uint8_t sendlen = 0;
+    if(pCrc != NULL)
+        *pCrc = Crc16(*pCrc, ch);
+    pTransport->write(&ch, 1);
+    if(ch == TELNET_IAC && pTransport->IsTelnet())
+        pTransport->write(&ch, 1);
+}
 
-    cmdBuf[1] = 'r';
-    cmdBuf[3] = 0;
-    if(dir)
-        cmdBuf[0] = 'd';
-    else
-        cmdBuf[0] = '-';
+void microBoxEsp::BinEnd(const __FlashStringHelper *msg)
+{
+    binMode = BIN_OFF;
+    pTransport->StartCoalesce();
+    pTransport->println();
+    if(msg != NULL)
+    {
+        pTransport->print(F("bin: "));
+        pTransport->println(msg);
+    }
+    ShowPrompt();
+    pTransport->EndCoalesce();
+}
+#endif
 
-    if(rw)
-        cmdBuf[2] = 'w';
-    else
-        cmdBuf[2] = '-';
+#if MB_FEATURE_PROFILER || MB_FEATURE_RECORDER || MB_FEATURE_TRACE
+void microBoxEsp::PrintStat(const __FlashStringHelper *name, int32_t val)
+{
+    char buf[12];
 
-    strcat_P(cmdBuf, PSTR("xr-xr-x\t2 root\troot\t"));
-    if(listLong)
-        sendlen = strlen(cmdBuf) + esp8266.GetIntLen(len) + strlen_P(fileDate) + 2;
-    if(name != NULL)
-        sendlen += strlen(name)+2;
-    esp8266.SendHeader(sendlen);
-    if(listLong)
+    pTransport->print(name);
+    pTransport->print(F("\t"));
+    if(val < 0)
+        pTransport->println(F("n/a"));
+    else
     {
-        pSerial->print(cmdBuf);
-
-        pSerial->print((uint16_t)len);
-        pSerial->print(F(" "));
-        pSerial->print((const __FlashStringHelper*)fileDate);
-        pSerial->print(F(" "));
+        ltoa(val, buf, 10);
+        pTransport->println(buf);
     }
-    if(name != NULL)
-        pSerial->println(name);
-
-    esp8266.WaitForSendComplete();
-    cmdBuf[0] = 0;
 }
+#endif
 
-void microBoxEsp::ListDir(char **pParam, uint8_t parCnt, bool listLong)
+#if MB_FEATURE_PROFILER
+void microBoxEsp::ShowProc(uint8_t idx)
 {
     uint8_t i=0;
-    char *dir;
+    char buf[12];
 
-    if(parCnt != 0)
+    pTransport->StartCoalesce();
+    if(idx == PROC_CMDS)
     {
-        dir = GetDir(pParam[0], false);
-        if(dir == NULL)
+        pTransport->println(F("cmd\tcalls\tavg_us\tmax_us"));
+        for(i=0;i<CmdCount();i++)
         {
-            if(listLong)
-                ErrorDir(F("ll"));
-            else
-                ErrorDir(F("ls"));
-            return;
+            uint8_t cmd = CmdSorted(i);
+            CMD_STAT *pStat = &cmdStats[cmd];
+
+            PrintCmdName(cmd);
+            pTransport->print(F("\t"));
+            ultoa(pStat->calls, buf, 10);
+            pTransport->print(buf);
+            pTransport->print(F("\t"));
+            ultoa(pStat->calls ? pStat->timeUs / pStat->calls : 0, buf, 10);
+            pTransport->print(buf);
+            pTransport->print(F("\t"));
+            ultoa(pStat->maxUs, buf, 10);
+            pTransport->println(buf);
         }
     }
-    else
-    {
-        dir = currentDir;
-    }
-
-    if(dir[1] == 0)
+    else if(idx == PROC_CONF)
     {
-        cmdBuf[0] = 0;
-        while(pgm_read_byte_near(&dirList[i][0]) != 0)
-        {
-            if(listLong)
-            {
-                ListDirHlp(true);
-                esp8266.println((__FlashStringHelper*)dirList[i]);
-            }
-            else
-            {
-                strcat_P(cmdBuf, dirList[i]);
-                strcat_P(cmdBuf, PSTR("\t"));
-            }
-            i++;
-        }
-        esp8266.println(cmdBuf);
+        PrintStat(F("watch"), MB_FEATURE_WATCH);
+        PrintStat(F("eeprom"), MB_FEATURE_EEPROM);
+        PrintStat(F("login"), MB_FEATURE_LOGIN);
+        PrintStat(F("history"), MB_FEATURE_HISTORY);
+        PrintStat(F("completion"), MB_FEATURE_COMPLETION);
+        PrintStat(F("scripts"), MB_FEATURE_SCRIPTS);
+        PrintStat(F("dumpload"), MB_FEATURE_DUMPLOAD);
+        PrintStat(F("profiler"), MB_FEATURE_PROFILER);
+        PrintStat(F("recorder"), MB_FEATURE_RECORDER);
+        PrintStat(F("binary"), MB_FEATURE_BINARY);
+        PrintStat(F("transaction"), MB_FEATURE_TRANSACTION);
+        PrintStat(F("getcache"), MB_FEATURE_GETCACHE);
+        PrintStat(F("seqlock"), MB_FEATURE_SEQLOCK);
+        PrintStat(F("stream"), MB_FEATURE_STREAM);
+        PrintStat(F("trace"), MB_FEATURE_TRACE);
+        PrintStat(F("tmpfs"), MB_FEATURE_TMPFS);
+        // RAM in bytes, flash is reported by the toolchain
+        PrintStat(F("ram_session"), sizeof(microBoxEsp));
+        PrintStat(F("ram_cmds"), sizeof(Cmds) + sizeof(cmdStats));
+#if MB_FEATURE_SCRIPTS
+        PrintStat(F("ram_scripts"), sizeof(Scripts) + MAX_SCRIPT_DEPTH * cmdBufSize);
+#endif
+        PrintStat(F("ram_nodes"), (int32_t)nodeCnt * sizeof(MB_NODE));
+        PrintStat(F("ram_cmdbuf"), cmdBufSize);
+        PrintStat(F("ram_args"), maxArgs * sizeof(char*));
+#if MB_FEATURE_HISTORY
+        PrintStat(F("ram_history"), historyBufSize);
+#endif
     }
-    else if(strcmp_P(dir, PSTR("/bin")) == 0)
+    else if(idx == PROC_LOOP)
     {
-        while(Cmds[i].cmdName != NULL)
-        {
-            ListDirHlp(false, Cmds[i].cmdName, listLong);
-            i++;
-        }
+        PrintStat(F("loop_hz"), loopHz);
+        PrintStat(F("parse_min_us"), parseCnt ? parseMinUs : 0);
+        PrintStat(F("parse_avg_us"), parseCnt ? parseSumUs / parseCnt : 0);
+        PrintStat(F("parse_max_us"), parseMaxUs);
     }
-    else if(strcmp_P(dir, PSTR("/dev")) == 0)
+    else if(idx == PROC_MEM)
     {
-        while(Params[i].paramName != NULL)
-        {
-            uint8_t size;
-            if(Params[i].parType&PARTYPE_INT)
-                size = sizeof(int);
-            else if(Params[i].parType&PARTYPE_DOUBLE)
-                size = sizeof(double);
-            else
-                size = Params[i].len;
-
-            ListDirHlp(false, Params[i].paramName, listLong, Params[i].parType&PARTYPE_RW, size);
-            i++;
-        }
+        PrintStat(F("free_ram"), FreeRam());
+        PrintStat(F("stack_free_min"), StackFree());
     }
+    pTransport->EndCoalesce();
 }
 
-void microBoxEsp::ChangeDir(char **pParam, uint8_t parCnt)
+// Bytes between heap and stack
+int microBoxEsp::FreeRam()
 {
-    char *dir;
+#ifdef __AVR__
+    char top;
 
-    if(pParam[0] != NULL)
-    {
-        dir = GetDir(pParam[0], false);
-        if(dir != NULL)
-        {
-            strcpy(currentDir, dir);
-            return;
-        }
-    }
-    ErrorDir(F("cd"));
+    return &top - (__brkval == 0 ? &__heap_start : __brkval);
+#else
+    return -1;
+#endif
 }
 
-void microBoxEsp::PrintParam(uint8_t idx)
+// Fills the gap between heap and stack with STACK_CANARY. The bytes the
+// stack has not reached since are still untouched, see StackFree().
+void microBoxEsp::PaintStack()
 {
-    if(Params[idx].getFunc != NULL)
-        (*Params[idx].getFunc)(Params[idx].id);
+#ifdef __AVR__
+    char top;
+    char *p = (__brkval == 0 ? &__heap_start : __brkval);
 
-    if(Params[idx].parType&PARTYPE_INT)
-        esp8266.print(*((int*)Params[idx].pParam));
-    else if(Params[idx].parType&PARTYPE_DOUBLE)
-        esp8266.print(*((double*)Params[idx].pParam), 8);
-    else
-        esp8266.print(((char*)Params[idx].pParam));
+    while(p < &top - 16)
+        *p++ = STACK_CANARY;
+#endif
+}
 
-    if(csvMode)
-    {
-        esp8266.print(';');
-    }
-    else
-        esp8266.println();
+// Smallest gap between heap and stack since the last PaintStack()
+int microBoxEsp::StackFree()
+{
+#ifdef __AVR__
+    char top;
+    char *p = (__brkval == 0 ? &__heap_start : __brkval);
+    int cnt = 0;
+
+    while(p < &top && *p++ == (char)STACK_CANARY)
+        cnt++;
+    return cnt;
+#else
+    return -1;
+#endif
 }
 
-int8_t microBoxEsp::GetParamIdx(char *pParam, bool partStr, int8_t startIdx)
+// Clears all profiler counters of /proc
+void microBoxEsp::Reset()
 {
-    int8_t i=startIdx;
-    char *dir;
-    char *file;
+    memset(cmdStats, 0, sizeof(cmdStats));
+    parseCnt = 0;
+    parseSumUs = 0;
+    parseMinUs = 0xffffffffUL;
+    parseMaxUs = 0;
+    loopCnt = 0;
+    loopHz = 0;
+    loopTimeout = millis();
+    PaintStack();
+}
+#endif
 
-    if(pParam != NULL)
-    {
-        dir = GetDir(pParam, true);
-        if(dir == NULL)
-            dir = currentDir;
-        if(dir != NULL)
-        {
-            if(strcmp_P(dir, PSTR("/dev")) == 0)
-            {
-                file = GetFile(pParam);
-                if(file != NULL)
-                {
-                    while(Params[i].paramName != NULL)
-                    {
-                        if(partStr)
-                        {
-                            if(strncmp(Params[i].paramName, file, strlen(file))== 0)
-                            {
-                                return i;
-                            }
-                        }
-                        else
-                        {
-                            if(strcmp(Params[i].paramName, file)== 0)
-                            {
-                                return i;
-                            }
-                        }
-                        i++;
-                    }
-                }
-            }
-        }
-    }
-    return -1;
+#if MB_FEATURE_TMPFS
+// Files in /tmp are shared by all sessions, the memory stays with the caller
+void microBoxEsp::SetTmpBuffer(uint8_t *pBuf, uint16_t size)
+{
+    TmpFs.begin(pBuf, size);
 }
 
-// Taken from Stream.cpp
-double microBoxEsp::parseFloat(char *pBuf)
+// Name of a file in /tmp for paths like /tmp/snap, or snap within /tmp,
+// NULL for other paths
+const char *microBoxEsp::TmpName(const char *pPath)
 {
-    boolean isNegative = false;
-    boolean isFraction = false;
-    long value = 0;
-    unsigned char c;
-    double fraction = 1.0;
-    uint8_t idx = 0;
+    const char *pName = strrchr(pPath, '/');
 
-    c = pBuf[idx++];
-    // ignore non numeric leading characters
-    if(c > 127)
-        return 0; // zero returned if timeout
+    if(pName == NULL)
+        return curNode == NODE_TMP ? pPath : NULL;
+    if(pName == pPath || ResolvePath(curNode, pPath, pName - pPath) != NODE_TMP)
+        return NULL;
+    return pName + 1;
+}
 
-    do{
-        if(c == '-')
-            isNegative = true;
-        else if (c == '.')
-            isFraction = true;
-        else if(c >= '0' && c <= '9')  {      // is c a digit?
-            value = value * 10 + c - '0';
-            if(isFraction)
-                fraction *= 0.1;
-        }
-        c = pBuf[idx++];
-    }
-    while( (c >= '0' && c <= '9')  || c == '.');
+// exit, bin and watch keep using the connection after they returned,
+// their output can not go into a file
+bool microBoxEsp::CanRedirect(uint8_t idx)
+{
+    void (*cmdFunc)(char **param, uint8_t parCnt);
 
-    if(isNegative)
-        value = -value;
-    if(isFraction)
-        return value * fraction;
-    else
-        return value;
+    if(idx >= BUILTIN_NUM)
+        return true;
+    memcpy_P(&cmdFunc, &Builtins[idx].cmdFunc, sizeof(cmdFunc));
+    if(cmdFunc == ExitCB)
+        return false;
+#if MB_FEATURE_BINARY
+    if(cmdFunc == BinaryCB)
+        return false;
+#endif
+#if MB_FEATURE_WATCH
+    if(cmdFunc == watchCB || cmdFunc == watchcsvCB)
+        return false;
+#endif
+    return true;
 }
 
-// echo 82.00 > /dev/param
-void microBoxEsp::Echo(char **pParam, uint8_t parCnt)
+// rm path [path..], only files in /tmp can be removed
+void microBoxEsp::Remove(char **pParam, uint8_t parCnt)
 {
-    uint8_t idx;
+    const char *pName;
+    uint8_t i;
 
-    if((parCnt == 3) && (strcmp_P(pParam[1], PSTR(">")) == 0))
+    if(parCnt == 0)
     {
-        idx = GetParamIdx(pParam[2]);
-        if(idx != -1)
+        cmdError = true;
+        pTransport->println(F("rm: Usage path [path..]"));
+        return;
+    }
+    for(i=0;i<parCnt;i++)
+    {
+        pName = TmpName(pParam[i]);
+        if(pName == NULL)
         {
-            if(Params[idx].parType & PARTYPE_RW)
-            {
-                if(Params[idx].parType & PARTYPE_INT)
-                {
-                    int val;
-
-                    val = atoi(pParam[0]);
-                    *((int*)Params[idx].pParam) = val;
-                }
-                else if(Params[idx].parType & PARTYPE_DOUBLE)
-                {
-                    double val;
-
-                    val = parseFloat(pParam[0]);
-                    *((double*)Params[idx].pParam) = val;
-                }
-                else
-                {
-                    if(strlen(pParam[0]) < Params[idx].len)
-                        strcpy((char*)Params[idx].pParam, pParam[0]);
-                }
-                if(Params[idx].setFunc != NULL)
-                    (*Params[idx].setFunc)(Params[idx].id);
-            }
-            else
-                esp8266.println(F("echo: File readonly"));
+            cmdError = true;
+            pTransport->println(F("rm: Read-only file system"));
         }
-        else
+        else if(!TmpFs.Remove(pName))
+            ErrorDir(F("rm"));
+    }
+}
+#endif
+
+#if MB_FEATURE_TRACE
+// trace start | stop | status | dump
+// Records the traffic with the esp8266 into the ring given to
+// Esp8266::SetTraceBuffer()
+void microBoxEsp::Trace(char **pParam, uint8_t parCnt)
+{
+    if(parCnt == 1 && strcmp_P(pParam[0], PSTR("start")) == 0)
+    {
+        if(esp8266.TraceCapacity() == 0)
         {
-            ErrorDir(F("echo"));
+            cmdError = true;
+            pTransport->println(F("trace: No buffer"));
         }
+        else
+            esp8266.TraceStart();
     }
+    else if(parCnt == 1 && strcmp_P(pParam[0], PSTR("stop")) == 0)
+        esp8266.TraceStop();
+    else if(parCnt == 1 && strcmp_P(pParam[0], PSTR("status")) == 0)
+        TraceStatus();
+    else if(parCnt == 1 && strcmp_P(pParam[0], PSTR("dump")) == 0)
+        TraceDump();
     else
     {
-        for(idx=0;idx<parCnt;idx++)
-        {
-            esp8266.print(pParam[idx]);
-            esp8266.print(F(" "));
-        }
-        esp8266.println();
+        cmdError = true;
+        pTransport->println(F("usage: trace start | stop | status | dump"));
     }
 }
 
-void microBoxEsp::Cat(char **pParam, uint8_t parCnt)
+void microBoxEsp::TraceStatus()
 {
-    Cat_int(pParam[0]);
+    pTransport->StartCoalesce();
+    pTransport->print(F("state\t"));
+    if(esp8266.TraceActive())
+        pTransport->println(F("tracing"));
+    else
+        pTransport->println(F("stopped"));
+    PrintStat(F("entries"), esp8266.TraceCount());
+    PrintStat(F("capacity"), esp8266.TraceCapacity());
+    PrintStat(F("overwritten"), esp8266.TraceTotal() - esp8266.TraceCount());
+    pTransport->EndCoalesce();
 }
 
-uint8_t microBoxEsp::Cat_int(char *pParam)
+// One line per run of bytes in one direction without a pause, oldest
+// first: +ms since the line before, > sent to or < received from the
+// module, and the bytes in hex. Tracing stops so the dump does not
+// overwrite the ring it reads.
+void microBoxEsp::TraceDump()
 {
-    int8_t idx;
-
-    idx = GetParamIdx(pParam);
-    if(idx != -1)
+    uint16_t pos = State();
+    uint16_t next, delta;
+    uint8_t dir, ch, n, lines;
+    char buf[8];
+
+    esp8266.TraceStop();
+    pTransport->StartCoalesce();
+    for(lines=0;lines<STREAM_LINES;lines++)
     {
-        PrintParam(idx);
-        return 1;
+        dir = esp8266.TraceRead(&pos, &delta, &ch);
+        if(!dir)
+            break;
+        pTransport->print(F("+"));
+        ultoa(delta, buf, 10);
+        pTransport->print(buf);
+        pTransport->print(dir == TRACE_TX ? F(" >") : F(" <"));
+        n = 0;
+        while(true)
+        {
+            buf[0] = ' ';
+            buf[1] = (ch >> 4) < 10 ? '0' + (ch >> 4) : 'a' - 10 + (ch >> 4);
+            buf[2] = (ch & 0x0f) < 10 ? '0' + (ch & 0x0f) : 'a' - 10 + (ch & 0x0f);
+            pTransport->write((const uint8_t*)buf, 3);
+            n++;
+            next = pos;
+            if(n >= TRACE_LINE_BYTES || esp8266.TraceRead(&next, &delta, &ch) != dir || delta != 0)
+                break;
+            pos = next;
+        }
+        pTransport->println();
     }
-    else
-        ErrorDir(F("cat"));
-    
-    return 0;
+    pTransport->EndCoalesce();
+    if(lines == STREAM_LINES && pos < esp8266.TraceCount())
+        More(pos);
 }
+#endif
 
-void microBoxEsp::watch(char **pParam, uint8_t parCnt)
+#if MB_FEATURE_DUMPLOAD
+void microBoxEsp::Dump(char **pParam, uint8_t parCnt)
 {
-    if(parCnt == 2)
+    uint16_t i = State();
+    uint8_t n;
+
+    for(n=0;n<STREAM_LINES && Params[i].paramName != NULL;n++)
     {
-        if(strncmp_P(pParam[0], PSTR("cat"), 3) == 0)
-        {
-            if(Cat_int(pParam[1]))
-            {
-                strcpy(cmdBuf, pParam[1]);
-                watchMode = true;
-            }
-        }
+        pTransport->print(Params[i].paramName);
+        pTransport->print(F("="));
+        PrintParam(i);
+        i++;
     }
+    if(Params[i].paramName != NULL)
+        More(i);
 }
 
-void microBoxEsp::watchcsv(char **pParam, uint8_t parCnt)
+// load [name=value ...]
+// Without arguments the following lines are read as name=value
+// until an empty line is received.
+void microBoxEsp::Load(char **pParam, uint8_t parCnt)
 {
-    watch(pParam, parCnt);
-    if(watchMode)
-        csvMode = true;
+    uint8_t i;
+
+    loadCnt = 0;
+    loadErrors = 0;
+    pendingCnt = 0;
+    if(parCnt == 0)
+    {
+        loadMode = true;
+        return;
+    }
+    for(i=0;i<parCnt;i++)
+        LoadLine(pParam[i]);
+    CommitSetFuncs();
+    if(loadErrors)
+    {
+        cmdError = true;
+        pTransport->print(F("load: "));
+        pTransport->print(loadErrors);
+        pTransport->println(F(" errors"));
+    }
 }
+#endif
 
 void microBoxEsp::Exit()
 {
-    esp8266.Disconnect(F("0"));
+    pTransport->Close();
     loginState = STATE_LOGIN_DISCONNECTED;
 }
 
+#if MB_FEATURE_EEPROM
 void microBoxEsp::ReadWriteParamEE(bool write)
 {
-    uint8_t i=0;
-    uint8_t psize;
+    uint16_t i=0;
+    uint16_t psize;
     int pos=0;
+    double snap;
 
     while(Params[i].paramName != NULL)
     {
-        if(Params[i].parType&PARTYPE_INT)
+        if(Params[i].parType&PARTYPE_ARRAY)
+            psize = Params[i].len * ((Params[i].parType&PARTYPE_INT) ? sizeof(int) : sizeof(double));
+        else if(Params[i].parType&PARTYPE_INT)
             psize = sizeof(uint16_t);
         else if(Params[i].parType&PARTYPE_DOUBLE)
             psize = sizeof(double);
         else
             psize = Params[i].len;
 
-        if(write)
-            eeprom_write_block(Params[i].pParam, (void*)pos, psize);
+        if(write && !(Params[i].parType & (PARTYPE_ARRAY|PARTYPE_STRING)))
+        {
+            // Scalars are saved from a consistent copy
+            ReadParam(i, &snap, psize);
+            eeprom_write_block(&snap, (void*)(uintptr_t)pos, psize);
+        }
+        else if(write)
+            eeprom_write_block(Params[i].pParam, (void*)(uintptr_t)pos, psize);
         else
-            eeprom_read_block(Params[i].pParam, (void*)pos, psize);
+            eeprom_read_block(Params[i].pParam, (void*)(uintptr_t)pos, psize);
         pos += psize;
         i++;
     }
 }
+#endif
 
 void microBoxEsp::ListDirCB(char **pParam, uint8_t parCnt)
 {
-    microbox.ListDir(pParam, parCnt);
+    pActive->ListDir(pParam, parCnt);
 }
 
 void microBoxEsp::ListLongCB(char **pParam, uint8_t parCnt)
 {
-    microbox.ListDir(pParam, parCnt, true);
+    pActive->ListDir(pParam, parCnt, true);
 }
 
 void microBoxEsp::ChangeDirCB(char **pParam, uint8_t parCnt)
 {
-    microbox.ChangeDir(pParam, parCnt);
+    pActive->ChangeDir(pParam, parCnt);
 }
 
 void microBoxEsp::EchoCB(char **pParam, uint8_t parCnt)
 {
-    microbox.Echo(pParam, parCnt);
+    pActive->Echo(pParam, parCnt);
 }
 
 void microBoxEsp::ExitCB(char **pParam, uint8_t parCnt)
 {
-    microbox.Exit();
+    pActive->Exit();
 }
 
 void microBoxEsp::CatCB(char **pParam, uint8_t parCnt)
 {
-    microbox.Cat(pParam, parCnt);
+    pActive->Cat(pParam, parCnt);
 }
 
+#if MB_FEATURE_WATCH
 void microBoxEsp::watchCB(char **pParam, uint8_t parCnt)
 {
-    microbox.watch(pParam, parCnt);
+    pActive->watch(pParam, parCnt);
 }
 
 void microBoxEsp::watchcsvCB(char **pParam, uint8_t parCnt)
 {
-    microbox.watchcsv(pParam, parCnt);
+    pActive->watchcsv(pParam, parCnt);
 }
+#endif
 
+#if MB_FEATURE_EEPROM
 void microBoxEsp::LoadParCB(char **pParam, uint8_t parCnt)
 {
-    microbox.ReadWriteParamEE(false);
+    pActive->ReadWriteParamEE(false);
 }
 
 void microBoxEsp::SaveParCB(char **pParam, uint8_t parCnt)
 {
-    microbox.ReadWriteParamEE(true);
+    pActive->ReadWriteParamEE(true);
+}
+#endif
+
+#if MB_FEATURE_SCRIPTS
+void microBoxEsp::ShellCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Shell(pParam, parCnt);
+}
+#endif
+
+#if MB_FEATURE_DUMPLOAD
+void microBoxEsp::DumpCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Dump(pParam, parCnt);
+}
+
+void microBoxEsp::LoadCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Load(pParam, parCnt);
+}
+#endif
+
+#if MB_FEATURE_RECORDER
+void microBoxEsp::RecordCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Record(pParam, parCnt);
+}
+#endif
+
+#if MB_FEATURE_TMPFS
+void microBoxEsp::RemoveCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Remove(pParam, parCnt);
+}
+#endif
+
+#if MB_FEATURE_TRACE
+void microBoxEsp::TraceCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Trace(pParam, parCnt);
+}
+#endif
+
+#if MB_FEATURE_BINARY
+void microBoxEsp::BinaryCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Binary(pParam, parCnt);
+}
+#endif
+
+#if MB_FEATURE_TRANSACTION
+void microBoxEsp::BeginCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Begin(pParam, parCnt);
+}
+
+void microBoxEsp::CommitCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Commit(pParam, parCnt);
+}
+
+void microBoxEsp::AbortCB(char **pParam, uint8_t parCnt)
+{
+    pActive->Abort(pParam, parCnt);
 }
+#endif
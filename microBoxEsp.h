@@ -11,23 +11,110 @@
 
 #define __PROG_TYPES_COMPAT__
 #include <Arduino.h>
+#include <mbTransport.h>
 #include <esp8266.h>
+#include <serialTransport.h>
+#include <mbTmpFs.h>
+#include <microBoxConfig.h>
 
-#define MAX_CMD_NUM 20
-
-#define MAX_CMD_BUF_SIZE 40
-#define MAX_PATH_LEN 10
+#define WATCH_INTERVALL   500
+#define WATCH_POLL_MS     100   // Sample rate of watch -d/-h
+#define WATCH_HEARTBEAT   10    // Seconds, default for watch -d
+#define WATCH_SAMPLE_MS   10    // Sample rate of watch -w
+#define WATCH_PACE_MAX    8000  // Slowest interval on a congested link
+#define STREAM_LINES      8     // Lines per cmdParser() pass of ll, dump and trace dump
+#define TRACE_LINE_BYTES  16    // Bytes per line of trace dump
 
 #define PARTYPE_INT    0x01
 #define PARTYPE_DOUBLE 0x02
 #define PARTYPE_STRING 0x04
+#define PARTYPE_ARRAY  0x08   // With PARTYPE_INT or PARTYPE_DOUBLE
 #define PARTYPE_RW     0x10
 #define PARTYPE_RO     0x00
+#define PARTYPE_SEQLOCK 0x20  // Int or double written under a SetSeqLock() counter
+
+// Writers of a PARTYPE_SEQLOCK parameter, e.g. a timer ISR, wrap the
+// update so the shell never prints or saves a half written value:
+// MB_SEQ_BEGIN(tempSeq); temp = t; MB_SEQ_END(tempSeq);
+#define MB_SEQ_BEGIN(seq) do { (seq)++; __asm__ __volatile__("" ::: "memory"); } while(0)
+#define MB_SEQ_END(seq)   do { __asm__ __volatile__("" ::: "memory"); (seq)++; } while(0)
+
+#define NODE_DIR   0x01
+#define NODE_PARAM 0x02
+#define NODE_FLASH 0x04
+#define NODE_PROC  0x08
+
+// Fixed nodes, the directories follow the order of dirList[]
+#define NODE_ROOT 0
+#define NODE_BIN  1
+#define NODE_DEV  2
+#define NODE_ETC  3
+#define NODE_PROC_DIR 5
+#define NODE_TMP  8
+
+// Files in /proc, in the order of procList[]
+#define PROC_CMDS 0
+#define PROC_CONF 1
+#define PROC_LOOP 2
+#define PROC_MEM  3
+#define PROC_RESET 4
+
+#define STACK_CANARY 0xc5
+
+// Errors of ParseCmdParams()
+#define PARSE_ERR_ARGS  -1
+#define PARSE_ERR_QUOTE -2
+
+// Binary transfer frames: SOH type seq len payload crc16
+#define BIN_SOH      0x01
+#define BIN_DATA     'D'
+#define BIN_END      'E'    // Payload: offset (size) in 2 bytes
+#define BIN_ACK      'A'    // Payload: next expected offset
+#define BIN_NAK      'N'    // Payload: offset to resend from
+#define BIN_CANCEL   'C'
+#define BIN_CHUNK    64
+#define BIN_RETRY_MS 1000   // get: resend an unacknowledged frame
+#define BIN_RETRIES  5
+#define BIN_TIMEOUT  5000   // put: abort without frames
+
+#define BIN_OFF 0
+#define BIN_PUT 1
+#define BIN_GET 2
+
+#define BIN_RX_SOH  0
+#define BIN_RX_TYPE 1
+#define BIN_RX_SEQ  2
+#define BIN_RX_LEN  3
+#define BIN_RX_DATA 4
+#define BIN_RX_CRC1 5
+#define BIN_RX_CRC2 6
 
 #define ESC_STATE_NONE 0
 #define ESC_STATE_START 1
 #define ESC_STATE_CODE 2
 
+#define TELNET_IAC  0xFF
+#define TELNET_DONT 0xFE
+#define TELNET_DO   0xFD
+#define TELNET_WONT 0xFC
+#define TELNET_WILL 0xFB
+#define TELNET_SB   0xFA
+#define TELNET_SE   0xF0
+
+#define TELNET_OPT_ECHO     1
+#define TELNET_OPT_SGA      3
+#define TELNET_OPT_LINEMODE 34
+
+#define TELNET_LM_MODE        1
+#define TELNET_LM_FORWARDMASK 2
+#define TELNET_LM_MODE_EDIT   1
+
+#define TELNET_STATE_DATA   0
+#define TELNET_STATE_IAC    1
+#define TELNET_STATE_OPT    2
+#define TELNET_STATE_SB     3
+#define TELNET_STATE_SB_IAC 4
+
 #define STATE_LOGIN_DISCONNECTED    0
 #define STATE_LOGIN_CONNECTED       1
 #define STATE_LOGIN_USERNAME        2
@@ -40,12 +127,40 @@
 #define STATE_LOGIN_WRONG_USER_PASSWORD3       9
 #define STATE_LOGIN_USER_ERROR                 10
 
+// The structs below keep their layout whatever the MB_FEATURE_*
+// switches are, fields of a feature left out are ignored.
+
+// Commands added with AddCommand()
 typedef struct
 {
     const char *cmdName;
     void (*cmdFunc)(char **param, uint8_t parCnt);
 }CMD_ENTRY;
 
+// Built-in commands, the table stays in flash
+typedef struct
+{
+    char cmdName[9];
+    void (*cmdFunc)(char **param, uint8_t parCnt);
+}BUILTIN_ENTRY;
+
+// Shown in /proc/cmds
+typedef struct
+{
+    uint16_t calls;
+    uint32_t timeUs;
+    uint32_t maxUs;
+}CMD_STAT;
+
+typedef struct
+{
+    const char *scriptName;
+    const prog_char *script;
+}SCRIPT_ENTRY;
+
+// paramName may contain '/', "pid/kp" shows up as /dev/pid/kp.
+// A name must not be a parameter and a directory at the same time.
+// For PARTYPE_ARRAY pParam points to len elements of int or double.
 typedef struct
 {
     const char *paramName;
@@ -57,15 +172,93 @@ typedef struct
     uint8_t id;
 }PARAM_ENTRY;
 
+// SetMaxAge() table, the getFunc result of the parameter at pParam is
+// reused for maxAge ms or until InvalidateCache(). Ends with {NULL, 0}.
+typedef struct
+{
+    void *pParam;
+    uint16_t maxAge;
+}PARAM_AGE;
+
+// SetSeqLock() table, pSeq is the sequence counter of the
+// PARTYPE_SEQLOCK parameter at pParam. Ends with {NULL, NULL}.
+typedef struct
+{
+    void *pParam;
+    volatile uint8_t *pSeq;
+}PARAM_SEQ;
+
+// Last getFunc call of a parameter with maxAge
+typedef struct
+{
+    const PARAM_ENTRY *pEntry;
+    unsigned long time;
+    uint8_t gen;
+}GET_CACHE;
+
+// How begin() splits the arena. Zero sizes keep the transport's own
+// queues, historyLen 0 gives the rest of the arena to the history.
+// The node tree of the parameter table comes from the arena as well,
+// ArenaSize() is the size needed without the history.
+typedef struct
+{
+    uint8_t lineLen;
+    uint8_t maxArgs;
+    uint16_t txLen;
+    uint16_t rxLen;
+    uint16_t historyLen;
+}MB_LIMITS;
+
+typedef struct
+{
+    const char *name;
+    int16_t parent;
+    int16_t idx;        // First child of a directory or parameter index
+    uint16_t childCnt;
+    uint8_t nameLen;
+    uint8_t flags;
+}MB_NODE;
+
 class microBoxEsp
 {
+    friend class MbBench;   // extras/host/mbBench.cpp
+    friend class MbReplay;  // extras/host/mbReplay.cpp
+
 public:
     microBoxEsp();
     ~microBoxEsp();
-    void begin(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, char *histBuf = NULL, int historySize=0, HardwareSerial *serial=&Serial);
+    bool begin(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, char *histBuf = NULL, int historySize=0, HardwareSerial *serial=&Serial);
+    bool begin(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, char *histBuf, int historySize, MbTransport *transport);
+    bool begin(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, uint8_t *arena, uint16_t arenaSize, MbTransport *transport, const MB_LIMITS *pLimits = NULL);
+    static uint16_t ArenaSize(PARAM_ENTRY *pParams, const MB_LIMITS *pLimits = NULL);
+    MbTransport *GetTransport();
     void cmdParser();
     bool isTimeout(unsigned long *lastTime, unsigned long intervall);
     bool AddCommand(const char *cmdName, void (*cmdFunc)(char **param, uint8_t parCnt));
+#if MB_FEATURE_SCRIPTS
+    bool AddScript(const char *scriptName, const prog_char *script);
+#endif
+#if MB_FEATURE_RECORDER
+    void SetRecordBuffer(uint8_t *pBuf, uint16_t size);
+#endif
+#if MB_FEATURE_TRANSACTION
+    void SetTransactionBuffer(uint8_t *pBuf, uint16_t size);
+#endif
+#if MB_FEATURE_GETCACHE
+    void SetMaxAge(const PARAM_AGE *pTable);
+    static void InvalidateCache();
+#endif
+#if MB_FEATURE_SEQLOCK
+    void SetSeqLock(const PARAM_SEQ *pTable);
+#endif
+#if MB_FEATURE_TMPFS
+    static void SetTmpBuffer(uint8_t *pBuf, uint16_t size);
+#endif
+    // A command with more output calls More() before it returns and is
+    // called again with the same arguments on the next cmdParser() pass.
+    // State() is the value given to More(), 0 on the first call.
+    static void More(uint16_t state);
+    static uint16_t State();
 
 private:
     static void ListDirCB(char **pParam, uint8_t parCnt);
@@ -74,70 +267,357 @@ private:
     static void EchoCB(char **pParam, uint8_t parCnt);
     static void ExitCB(char **pParam, uint8_t parCnt);
     static void CatCB(char **pParam, uint8_t parCnt);
+#if MB_FEATURE_WATCH
     static void watchCB(char **pParam, uint8_t parCnt);
     static void watchcsvCB(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_EEPROM
     static void LoadParCB(char **pParam, uint8_t parCnt);
     static void SaveParCB(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_SCRIPTS
+    static void ShellCB(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_DUMPLOAD
+    static void DumpCB(char **pParam, uint8_t parCnt);
+    static void LoadCB(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_RECORDER
+    static void RecordCB(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_BINARY
+    static void BinaryCB(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_TRANSACTION
+    static void BeginCB(char **pParam, uint8_t parCnt);
+    static void CommitCB(char **pParam, uint8_t parCnt);
+    static void AbortCB(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_TRACE
+    static void TraceCB(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_TMPFS
+    static void RemoveCB(char **pParam, uint8_t parCnt);
+#endif
 
     void ListDir(char **pParam, uint8_t parCnt, bool listLong=false);
     void ChangeDir(char **pParam, uint8_t parCnt);
     void Echo(char **pParam, uint8_t parCnt);
     void Exit();
     void Cat(char **pParam, uint8_t parCnt);
+#if MB_FEATURE_WATCH
     void watch(char **pParam, uint8_t parCnt);
     void watchcsv(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_SCRIPTS
+    void Shell(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_DUMPLOAD
+    void Dump(char **pParam, uint8_t parCnt);
+    void Load(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_PROFILER
+    void Reset();
+#endif
+#if MB_FEATURE_RECORDER
+    void Record(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_BINARY
+    void Binary(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_TRANSACTION
+    void Begin(char **pParam, uint8_t parCnt);
+    void Commit(char **pParam, uint8_t parCnt);
+    void Abort(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_TRACE
+    void Trace(char **pParam, uint8_t parCnt);
+#endif
+#if MB_FEATURE_TMPFS
+    void Remove(char **pParam, uint8_t parCnt);
+#endif
 
 private:
+    void Init(PARAM_ENTRY *pParams, const char *hostName, const char *loginPassword, MbTransport *transport);
+    bool SetupArena(uint8_t *pArena, uint16_t size, const MB_LIMITS *pLimits);
     void ShowPrompt();
-    uint8_t ParseCmdParams(char *pParam);
+    int16_t ParseCmdParams(char *pParam);
     void ErrorDir(const __FlashStringHelper *cmd);
-    char *GetDir(char *pParam, bool useFile);
+    static uint16_t CountNodes(PARAM_ENTRY *pParams, uint16_t *pParamNum);
+    void BuildTree(uint16_t *pOrder);
+    void ExpandNode(uint16_t node, uint16_t *pOrder);
+    char NodeChar(uint16_t node, uint8_t pos);
+    int8_t EntryCmp(int16_t dir, uint16_t pos, const char *pStr, uint8_t len);
+    char EntryChar(int16_t dir, uint16_t pos, uint8_t i);
+    uint16_t FindPrefix(int16_t dir, const char *pStr, uint8_t len, bool upper);
+    int16_t GetChild(uint16_t dir, const char *pName, uint8_t len);
+    int16_t ResolvePath(int16_t start, const char *pPath, uint8_t len);
+    void PrintNodeName(uint16_t node);
+    void PrintPath(uint16_t node);
+    void ListNode(uint16_t node, bool listLong);
+    void ParseInput();
     char *GetFile(char *pParam);
-    void PrintParam(uint8_t idx);
-    int8_t GetParamIdx(char *pParam, bool partStr = false, int8_t startIdx = 0);
-    int8_t GetCmdIdx(char* pCmd, int8_t startIdx = 0);
+    void CallGetFunc(uint16_t idx);
+#if MB_FEATURE_GETCACHE
+    uint16_t MaxAge(uint16_t idx);
+#endif
+    void ReadParam(uint16_t idx, void *pDst, uint8_t size);
+#if MB_FEATURE_SEQLOCK
+    volatile uint8_t *SeqOf(uint16_t idx);
+#endif
+    void PrintParam(uint16_t idx, uint16_t first=0, uint16_t end=0xffff);
+    void PrintValue(uint16_t idx, uint16_t first=0, uint16_t end=0xffff);
+    int16_t GetParamIdx(char *pParam, uint16_t *pFirst=NULL, uint16_t *pEnd=NULL);
     uint8_t Cat_int(char *pParam);
+    bool WriteParam(uint16_t idx, char *pVal, uint16_t first=0, uint16_t end=0xffff);
+    uint16_t ParamSize(uint16_t idx);
     void ListDirHlp(bool dir, const char *name = NULL, bool listLong = true, bool rw = true, uint16_t len=4096);
-    uint8_t ParCmp(uint8_t idx1, uint8_t idx2, bool cmd=false);
+    void ExecCommand();
+    bool ExecLine(char *pLine, bool run=true);
+    bool ExecSingle(char *pCmd);
+    void CallCmd(uint8_t idx, uint8_t parCnt);
+    static int16_t FindCmd(const char *pCmd, uint8_t len);
+    static uint8_t CmdCount();
+    static uint8_t CmdSorted(uint8_t pos);
+    static char CmdChar(uint8_t idx, uint8_t i);
+    void PrintCmdName(uint8_t idx);
+    bool InScript();
+    bool Busy();
+#if MB_FEATURE_TMPFS
+    const char *TmpName(const char *pPath);
+    static bool CanRedirect(uint8_t idx);
+#endif
+#if MB_FEATURE_STREAM
+    void StreamStep();
+#endif
+    char *SplitCmdLine(char *pLine, bool *pAndNext);
+    bool HandleEscSeq(unsigned char ch);
+    bool HandleTelnet(unsigned char ch);
+    void TelnetOption(uint8_t cmd, uint8_t opt);
+    void SendTelnetCmd(uint8_t cmd, uint8_t opt);
+    void SetTelnetEcho(bool serverEcho);
+    double parseFloat(char *pBuf);
+    bool EchoInput();
+    void BlockreadSend();
+#if MB_FEATURE_PROFILER || MB_FEATURE_RECORDER || MB_FEATURE_TRACE
+    void PrintStat(const __FlashStringHelper *name, int32_t val);
+#endif
+#if MB_FEATURE_PROFILER
+    void ShowProc(uint8_t idx);
+    int FreeRam();
+    int StackFree();
+    void PaintStack();
+#endif
+#if MB_FEATURE_WATCH
+    double ParamValue(uint16_t idx);
+    void WatchChanges();
+    void WatchSend();
+    void WatchAggregate();
+    void PrintAggregate(double val, bool last);
+#endif
+#if MB_FEATURE_RECORDER
+    void RecordStart(char **pParam, uint8_t parCnt);
+    void RecordSample();
+    void RecordStatus();
+    void RecordDump();
+#endif
+#if MB_FEATURE_TRACE
+    void TraceStatus();
+    void TraceDump();
+#endif
+#if MB_FEATURE_DUMPLOAD
+    int16_t FindParam(char *pName);
+    bool LoadLine(char *pLine);
+    void EndLoad();
+#endif
+#if MB_FEATURE_DUMPLOAD || MB_FEATURE_TRANSACTION
+    void QueueSetFunc(uint16_t idx);
+    void CommitSetFuncs();
+#endif
+#if MB_FEATURE_TRANSACTION
+    uint8_t *FindStaged(uint16_t idx);
+    void SwapStaged(uint16_t idx, uint8_t *pStaged);
+    void StageParam(uint16_t idx, char *pVal, uint16_t first, uint16_t end);
+#endif
+#if MB_FEATURE_COMPLETION
+    void PrintEntryName(int16_t dir, uint16_t pos);
     void HandleTab();
+#endif
+#if MB_FEATURE_HISTORY
     void HistoryUp();
     void HistoryDown();
     void HistoryPrintHlpr();
     void AddToHistory(char *buf);
-    void ExecCommand();
-    bool HandleEscSeq(unsigned char ch);
-    double parseFloat(char *pBuf);
+#endif
+#if MB_FEATURE_SCRIPTS
+    int8_t GetScriptIdx(char *pName);
+    bool RunScript(uint8_t idx);
+#endif
+#if MB_FEATURE_LOGIN
     void HandleLogin();
     void PasswordPrompt();
+#endif
+#if MB_FEATURE_EEPROM
     void ReadWriteParamEE(bool write);
-    void BlockreadSend();
+#endif
+#if MB_FEATURE_BINARY
+    void BinPoll();
+    void BinInput(uint8_t ch);
+    void BinFrame();
+    void BinSendNext();
+    void BinSendFrame(uint8_t type, uint8_t seq, uint8_t len);
+    void BinSendByte(uint8_t ch, uint16_t *pCrc);
+    void BinEnd(const __FlashStringHelper *msg);
+#endif
 
 private:
-    char currentDir[MAX_PATH_LEN];
-
-    char cmdBuf[MAX_CMD_BUF_SIZE];
-    char dirBuf[15];
-    char *ParmPtr[10];
+    char *cmdBuf;
+    uint8_t cmdBufSize;
+    char **ParmPtr;
+    uint8_t maxArgs;
+    uint8_t *ownArena;
     uint8_t bufPos;
-    bool watchMode;
-    bool csvMode;
+    bool cmdError;
+    uint16_t streamState;
+    bool streamMore;
+#if MB_FEATURE_STREAM
+    int8_t streamCmd;       // Command index of a suspended command or -1
+    uint8_t streamParCnt;
+    char *streamNext;       // Rest of the command line
+    bool streamAndNext;
+#endif
     uint8_t escSeq;
-    unsigned long watchTimeout;
+    uint8_t telnetState;
+    uint8_t telnetCmd;
+    bool lineMode;
+    bool echoOff;
     const char* machName;
-    int historyBufSize;
-    char *historyBuf;
-    int historyWrPos;
-    int historyCursorPos;
-    bool loggedIn;
-    HardwareSerial *pSerial;
+    MbTransport *pTransport;
     uint8_t serAvail;
     uint8_t blockRead;
     uint8_t loginState;
-    const char *password;
 
+    static microBoxEsp *pActive;
+#if MB_FEATURE_SEQLOCK
+    const PARAM_SEQ *pSeqs;
+#endif
+#if MB_FEATURE_GETCACHE
+    const PARAM_AGE *pAges;
+    static uint8_t getGen;
+    static GET_CACHE getCache[MAX_GET_CACHE];
+#endif
+    static const BUILTIN_ENTRY Builtins[] PROGMEM;
     static CMD_ENTRY Cmds[MAX_CMD_NUM];
+#if MB_FEATURE_PROFILER
+    static CMD_STAT cmdStats[];     // Built-ins first, then Cmds[]
+#endif
     PARAM_ENTRY *Params;
+    MB_NODE *Nodes;
+    uint16_t nodeCnt;
+    int16_t curNode;
     static const char dirList[][5] PROGMEM;
+
+#if MB_FEATURE_LOGIN
+    const char *password;
+#endif
+#if MB_FEATURE_HISTORY
+    int historyBufSize;
+    char *historyBuf;
+    int historyWrPos;
+    int historyCursorPos;
+#endif
+#if MB_FEATURE_COMPLETION
+    bool tabPressed;
+#endif
+#if MB_FEATURE_SCRIPTS
+    static SCRIPT_ENTRY Scripts[MAX_SCRIPT_NUM];
+    char *scriptLines;      // A line of cmdBufSize per nesting level
+    uint8_t scriptDepth;
+#endif
+#if MB_FEATURE_TMPFS
+    static MbTmpFs TmpFs;
+#endif
+#if MB_FEATURE_DUMPLOAD
+    bool loadMode;
+    bool lineCut;           // Input line longer than cmdBuf
+    uint8_t loadCnt;
+    uint8_t loadErrors;
+#endif
+#if MB_FEATURE_DUMPLOAD || MB_FEATURE_TRANSACTION
+    uint16_t pendingSet[MAX_PENDING_SET];
+    uint8_t pendingCnt;
+#endif
+#if MB_FEATURE_TRANSACTION
+    uint8_t *txnBuf;        // Entries of parameter index and staged value
+    uint16_t txnSize;
+    uint16_t txnLen;
+    bool txnActive;
+#endif
+#if MB_FEATURE_WATCH
+    bool watchMode;
+    bool csvMode;
+    unsigned long watchTimeout;
+    bool watchOnChange;
+    int16_t watchIdx;
+    double watchDeadband;
+    double watchLast;
+    uint16_t watchHeartbeat;
+    unsigned long watchSent;
+    unsigned long watchWindow;
+    unsigned long watchWinStart;
+    uint16_t watchPace;
+    uint16_t watchLatency;
+    uint16_t watchDrops;
+    uint16_t aggCnt;
+    double aggMean;
+    double aggM2;
+    double aggMin;
+    double aggMax;
+#endif
+#if MB_FEATURE_RECORDER
+    uint8_t *recBuf;
+    uint16_t recSize;
+    uint16_t recIdx[MAX_REC_PARAMS];
+    uint8_t recParCnt;
+    uint8_t recRowLen;
+    uint16_t recRows;
+    uint16_t recHead;
+    uint16_t recCnt;
+    uint32_t recTotal;
+    uint16_t recIntervall;
+    unsigned long recNext;
+    uint32_t recSlot;       // Slot of the next sample, intervals since rec start
+    uint32_t recSkipped;
+    bool recActive;
+#endif
+#if MB_FEATURE_BINARY
+    uint8_t binMode;
+    uint8_t binRxState;
+    uint8_t binType;
+    uint8_t binSeq;
+    uint8_t binLen;
+    uint8_t binPos;
+    uint16_t binCrc;
+    uint16_t binRxCrc;
+    uint8_t *binPtr;        // NULL for the EEPROM
+    int16_t binIdx;
+    uint16_t binSize;
+    uint16_t binOffset;
+    uint8_t binChunk;
+    uint8_t binTxSeq;       // put: next expected, get: current frame
+    uint8_t binRetries;
+    unsigned long binTimeout;
+#endif
+#if MB_FEATURE_PROFILER
+    uint32_t parseCnt;
+    uint32_t parseSumUs;
+    uint32_t parseMinUs;
+    uint32_t parseMaxUs;
+    uint16_t loopCnt;
+    uint16_t loopHz;
+    unsigned long loopTimeout;
+    static const char procList[][6] PROGMEM;
+#endif
 };
 
 extern microBoxEsp microbox;
@@ -0,0 +1,64 @@
+/*
+  serialTransport.cpp - Raw serial transport for microBoxEsp.
+  Released under GPLv3.
+*/
+
+#include <serialTransport.h>
+
+SerialTransport::SerialTransport()
+{
+    pSerial = NULL;
+    status = STATUS_ESP_DISCONNECTED;
+}
+
+void SerialTransport::begin(HardwareSerial *serial)
+{
+    pSerial = serial;
+    status = STATUS_ESP_CONNECTED;
+}
+
+uint8_t SerialTransport::GetStatus()
+{
+    uint8_t ret = status;
+
+    // Report a closed session once, then start over with a new login
+    if(pSerial != NULL)
+        status = STATUS_ESP_CONNECTED;
+    return ret;
+}
+
+void SerialTransport::Close()
+{
+    status = STATUS_ESP_DISCONNECTED;
+}
+
+uint8_t SerialTransport::Receive()
+{
+    int avail = pSerial->available();
+
+    if(avail > 255)
+        avail = 255;
+    return avail;
+}
+
+char SerialTransport::read()
+{
+    return pSerial->read();
+}
+
+bool SerialTransport::available()
+{
+    return pSerial->available();
+}
+
+void SerialTransport::clearBuffer(uint8_t avail)
+{
+    while(pSerial->available())
+        pSerial->read();
+}
+
+void SerialTransport::write(const uint8_t *buffer, size_t size)
+{
+    if(status)
+        pSerial->write(buffer, size);
+}
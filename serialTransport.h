@@ -0,0 +1,32 @@
+/*
+  serialTransport.h - Raw serial transport for microBoxEsp.
+  Released under GPLv3.
+*/
+
+#ifndef _SERIALTRANSPORT_H_
+#define _SERIALTRANSPORT_H_
+
+#include <mbTransport.h>
+
+// Shell directly on a HardwareSerial port, no AT commands and no framing.
+// The line counts as connected all the time, exit only restarts the login.
+class SerialTransport : public MbTransport
+{
+public:
+    SerialTransport();
+    void begin(HardwareSerial *serial);
+
+    uint8_t GetStatus();
+    void Close();
+    uint8_t Receive();
+    char read();
+    bool available();
+    void clearBuffer(uint8_t avail = 0);
+    void write(const uint8_t *buffer, size_t size);
+
+private:
+    HardwareSerial *pSerial;
+    uint8_t status;
+};
+
+#endif